@@ -0,0 +1,176 @@
+// src/gstgeminibody.c
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgeminibody.h"
+#include "gstgeminiconvert.h"
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_gemini_vision_debug_category);
+#define GST_CAT_DEFAULT gst_gemini_vision_debug_category
+
+// curl reads the body in pieces of this size, larger than its 64 KB default
+// so a typical frame takes a handful of callbacks
+#define GEMINI_BODY_UPLOAD_BUFFER_SIZE (256 * 1024)
+
+typedef struct {
+	gsize start;                // Offset of the segment in the body
+	gsize size;                 // Bytes the segment adds to the body
+	gchar *text;                // Literal text, or NULL for a base64 segment
+	GstBuffer *buffer;          // Source of a base64 segment, mapped into map
+	GstMapInfo map;
+} GeminiBodySegment;
+
+struct _GstGeminiBody {
+	GArray *segments;
+	gsize size;
+	gsize pos;                  // Next byte curl reads
+};
+
+static void
+segment_clear(gpointer data) {
+	GeminiBodySegment *seg = data;
+
+	g_free(seg->text);
+	if (seg->buffer) {
+		gst_buffer_unmap(seg->buffer, &seg->map);
+		gst_buffer_unref(seg->buffer);
+	}
+}
+
+GstGeminiBody *
+gst_gemini_body_new (void) {
+	GstGeminiBody *body = g_new0(GstGeminiBody, 1);
+
+	body->segments = g_array_new(FALSE, TRUE, sizeof(GeminiBodySegment));
+	g_array_set_clear_func(body->segments, segment_clear);
+	return body;
+}
+
+void
+gst_gemini_body_free (GstGeminiBody *body) {
+	if (!body) {
+		return;
+	}
+	g_array_unref(body->segments);
+	g_free(body);
+}
+
+void
+gst_gemini_body_add_text (GstGeminiBody *body, const gchar *text, gssize len) {
+	GeminiBodySegment seg = { 0 };
+
+	seg.size = len < 0 ? strlen(text) : (gsize) len;
+	if (seg.size == 0) {
+		return;
+	}
+	seg.start = body->size;
+	seg.text = g_strndup(text, seg.size);
+	g_array_append_val(body->segments, seg);
+	body->size += seg.size;
+}
+
+gboolean
+gst_gemini_body_add_base64 (GstGeminiBody *body, GstBuffer *buffer) {
+	GeminiBodySegment seg = { 0 };
+
+	if (!gst_buffer_map(buffer, &seg.map, GST_MAP_READ)) {
+		return FALSE;
+	}
+	seg.buffer = gst_buffer_ref(buffer);
+	seg.start = body->size;
+	seg.size = (seg.map.size + 2) / 3 * 4;
+	g_array_append_val(body->segments, seg);
+	body->size += seg.size;
+	return TRUE;
+}
+
+gsize
+gst_gemini_body_get_size (const GstGeminiBody *body) {
+	return body->size;
+}
+
+// Copies up to room bytes of the segment's base64 output, starting at
+// offset. Whole groups go straight to dest, a group cut by offset or by the
+// end of dest is encoded into a small stash first.
+static gsize
+read_base64(const GeminiBodySegment *seg, gsize offset, gchar *dest, gsize room) {
+	const gsize group = offset / 4;
+	const gsize skip = offset % 4;
+	gsize full = MIN(room / 4, seg->size / 4 - group);
+
+	if (skip == 0 && full > 0) {
+		gst_gemini_base64_encode(seg->map.data + group * 3, MIN(full * 3, seg->map.size - group * 3), dest);
+		return full * 4;
+	}
+
+	gchar stash[4];
+	gsize n = MIN(4 - skip, room);
+	gst_gemini_base64_encode(seg->map.data + group * 3, MIN(3, seg->map.size - group * 3), stash);
+	memcpy(dest, stash + skip, n);
+	return n;
+}
+
+size_t
+gst_gemini_body_read (char *dest, size_t size, size_t nmemb, void *user_data) {
+	GstGeminiBody *body = user_data;
+	const gsize room = size * nmemb;
+	gsize done = 0;
+	guint i = 0;
+
+	while (done < room && body->pos < body->size) {
+		const GeminiBodySegment *seg;
+		gsize offset, n;
+
+		// Segments are few, the one holding pos is found by a short scan
+		while (g_array_index(body->segments, GeminiBodySegment, i).start +
+			g_array_index(body->segments, GeminiBodySegment, i).size <= body->pos) {
+			i++;
+		}
+		seg = &g_array_index(body->segments, GeminiBodySegment, i);
+		offset = body->pos - seg->start;
+
+		if (seg->text) {
+			n = MIN(seg->size - offset, room - done);
+			memcpy(dest + done, seg->text + offset, n);
+		} else {
+			n = read_base64(seg, offset, dest + done, room - done);
+		}
+		done += n;
+		body->pos += n;
+	}
+
+	return done;
+}
+
+// curl rewinds the body when it has to send it again, for example after a
+// redirect or when a reused connection turns out to be closed
+int
+gst_gemini_body_seek (void *user_data, curl_off_t offset, int origin) {
+	GstGeminiBody *body = user_data;
+
+	if (origin != SEEK_SET || offset < 0 || (gsize) offset > body->size) {
+		return CURL_SEEKFUNC_FAIL;
+	}
+	body->pos = (gsize) offset;
+	return CURL_SEEKFUNC_OK;
+}
+
+void
+gst_gemini_body_attach (GstGeminiBody *body, CURL *handle) {
+	body->pos = 0;
+
+	curl_easy_setopt(handle, CURLOPT_POST, 1L);
+	curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) body->size);
+	curl_easy_setopt(handle, CURLOPT_READFUNCTION, gst_gemini_body_read);
+	curl_easy_setopt(handle, CURLOPT_READDATA, body);
+	curl_easy_setopt(handle, CURLOPT_SEEKFUNCTION, gst_gemini_body_seek);
+	curl_easy_setopt(handle, CURLOPT_SEEKDATA, body);
+#if LIBCURL_VERSION_NUM >= 0x073e00
+	curl_easy_setopt(handle, CURLOPT_UPLOAD_BUFFERSIZE, (long) GEMINI_BODY_UPLOAD_BUFFER_SIZE);
+#endif
+
+	GST_LOG("Streaming request body of %" G_GSIZE_FORMAT " bytes in %u segments",
+		body->size, body->segments->len);
+}
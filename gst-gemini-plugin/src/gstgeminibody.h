@@ -0,0 +1,38 @@
+#ifndef __GST_GEMINI_BODY_H__
+#define __GST_GEMINI_BODY_H__
+
+#include <gst/gst.h>
+#include <curl/curl.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstGeminiBody GstGeminiBody;
+
+// A request body made of JSON text and images that are base64-encoded while
+// curl reads the body. Nothing the size of the image is allocated: the JPEG
+// buffers are mapped once and encoded straight into curl's upload buffer,
+// and the total size is known up front so no chunked encoding is needed.
+GstGeminiBody *gst_gemini_body_new (void);
+void gst_gemini_body_free (GstGeminiBody *body);
+
+// Appends text that is sent as-is
+void gst_gemini_body_add_text (GstGeminiBody *body, const gchar *text, gssize len);
+
+// Appends the base64 encoding of buffer, which is kept mapped until the body
+// is freed. Returns FALSE if the buffer cannot be mapped.
+gboolean gst_gemini_body_add_base64 (GstGeminiBody *body, GstBuffer *buffer);
+
+// Size of the whole body in bytes
+gsize gst_gemini_body_get_size (const GstGeminiBody *body);
+
+// Sets up POST, the size, the read and seek callbacks on handle. The body
+// must outlive the transfer.
+void gst_gemini_body_attach (GstGeminiBody *body, CURL *handle);
+
+// CURLOPT_READFUNCTION and CURLOPT_SEEKFUNCTION, with the body as user data
+size_t gst_gemini_body_read (char *dest, size_t size, size_t nmemb, void *user_data);
+int gst_gemini_body_seek (void *user_data, curl_off_t offset, int origin);
+
+G_END_DECLS
+
+#endif /* __GST_GEMINI_BODY_H__ */
@@ -0,0 +1,980 @@
+// src/gstgeminiconvert.c
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgeminiconvert.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMINI_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define GEMINI_HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+// --- Scalar kernels ---
+// One function per byte order so the inner loop works on constant offsets.
+#define DEFINE_C_KERNEL(name, ps, r, g, b)                           \
+	static void                                                        \
+	name (const GstGeminiRowConverter *conv, const guint8 *src,        \
+		guint8 *dst, gint width) {                                     \
+		for (gint i = 0; i < width; i++) {                             \
+			dst[0] = src[r];                                           \
+			dst[1] = src[g];                                           \
+			dst[2] = src[b];                                           \
+			src += ps;                                                 \
+			dst += 3;                                                  \
+		}                                                              \
+	}
+
+DEFINE_C_KERNEL (convert_c_bgr, 3, 2, 1, 0)
+DEFINE_C_KERNEL (convert_c_rgbx, 4, 0, 1, 2)
+DEFINE_C_KERNEL (convert_c_bgrx, 4, 2, 1, 0)
+DEFINE_C_KERNEL (convert_c_xrgb, 4, 1, 2, 3)
+DEFINE_C_KERNEL (convert_c_xbgr, 4, 3, 2, 1)
+
+static void
+convert_c_copy (const GstGeminiRowConverter *conv, const guint8 *src, guint8 *dst, gint width) {
+	memcpy(dst, src, (gsize) width * 3);
+}
+
+// Used for the tails left over by the vector kernels
+static inline void
+convert_c_generic (const GstGeminiRowConverter *conv, const guint8 *src, guint8 *dst, gint width) {
+	const guint ps = conv->src_pstride;
+	const guint8 r = conv->offsets[0], g = conv->offsets[1], b = conv->offsets[2];
+
+	for (gint i = 0; i < width; i++) {
+		dst[0] = src[r];
+		dst[1] = src[g];
+		dst[2] = src[b];
+		src += ps;
+		dst += 3;
+	}
+}
+
+static void
+deinterleave_c (const guint8 *src, guint8 *even, guint8 *odd, gint n) {
+	for (gint i = 0; i < n; i++) {
+		even[i] = src[2 * i];
+		odd[i] = src[2 * i + 1];
+	}
+}
+
+static void
+accumulate_c (guint16 *acc, const guint8 *src, gint n) {
+	for (gint i = 0; i < n; i++) {
+		acc[i] += src[i];
+	}
+}
+
+static guint64
+sad_c (const guint8 *a, const guint8 *b, gsize n) {
+	guint64 sum = 0;
+
+	for (gsize i = 0; i < n; i++) {
+		sum += (guint) ABS((gint) a[i] - (gint) b[i]);
+	}
+	return sum;
+}
+
+static const gchar base64_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Handles any length, the last group is padded with '='
+static void
+base64_encode_c (const guint8 *src, gsize len, gchar *dst) {
+	for (; len >= 3; len -= 3, src += 3, dst += 4) {
+		const guint32 v = (guint32) src[0] << 16 | (guint32) src[1] << 8 | src[2];
+		dst[0] = base64_alphabet[v >> 18];
+		dst[1] = base64_alphabet[(v >> 12) & 0x3F];
+		dst[2] = base64_alphabet[(v >> 6) & 0x3F];
+		dst[3] = base64_alphabet[v & 0x3F];
+	}
+	if (len > 0) {
+		const guint32 v = (guint32) src[0] << 16 | (len > 1 ? (guint32) src[1] << 8 : 0);
+		dst[0] = base64_alphabet[v >> 18];
+		dst[1] = base64_alphabet[(v >> 12) & 0x3F];
+		dst[2] = len > 1 ? base64_alphabet[(v >> 6) & 0x3F] : '=';
+		dst[3] = '=';
+	}
+}
+
+#ifdef GEMINI_HAVE_X86_KERNELS
+// --- SSSE3 kernel ---
+// Converts 16 pixels per iteration: the 3 or 4 input vectors are gathered
+// into 3 output vectors with pshufb, using the control bytes in conv->shuffle.
+// Only the (output, input) pairs that can overlap are evaluated.
+__attribute__((target("ssse3"))) static void
+convert_ssse3 (const GstGeminiRowConverter *conv, const guint8 *src, guint8 *dst, gint width) {
+	const __m128i *m = (const __m128i *) conv->shuffle; // m[k * 4 + j]
+	gint x = 0;
+
+	if (conv->src_pstride == 4) {
+		for (; x + 16 <= width; x += 16) {
+			__m128i v0 = _mm_loadu_si128((const __m128i *) (src + 0));
+			__m128i v1 = _mm_loadu_si128((const __m128i *) (src + 16));
+			__m128i v2 = _mm_loadu_si128((const __m128i *) (src + 32));
+			__m128i v3 = _mm_loadu_si128((const __m128i *) (src + 48));
+
+			__m128i o0 = _mm_or_si128(
+				_mm_shuffle_epi8(v0, _mm_loadu_si128(&m[0])),
+				_mm_shuffle_epi8(v1, _mm_loadu_si128(&m[1])));
+			__m128i o1 = _mm_or_si128(
+				_mm_shuffle_epi8(v1, _mm_loadu_si128(&m[5])),
+				_mm_shuffle_epi8(v2, _mm_loadu_si128(&m[6])));
+			__m128i o2 = _mm_or_si128(
+				_mm_shuffle_epi8(v2, _mm_loadu_si128(&m[10])),
+				_mm_shuffle_epi8(v3, _mm_loadu_si128(&m[11])));
+
+			_mm_storeu_si128((__m128i *) (dst + 0), o0);
+			_mm_storeu_si128((__m128i *) (dst + 16), o1);
+			_mm_storeu_si128((__m128i *) (dst + 32), o2);
+			src += 64;
+			dst += 48;
+		}
+	} else {
+		for (; x + 16 <= width; x += 16) {
+			__m128i v0 = _mm_loadu_si128((const __m128i *) (src + 0));
+			__m128i v1 = _mm_loadu_si128((const __m128i *) (src + 16));
+			__m128i v2 = _mm_loadu_si128((const __m128i *) (src + 32));
+
+			__m128i o0 = _mm_or_si128(
+				_mm_shuffle_epi8(v0, _mm_loadu_si128(&m[0])),
+				_mm_shuffle_epi8(v1, _mm_loadu_si128(&m[1])));
+			__m128i o1 = _mm_or_si128(
+				_mm_or_si128(
+					_mm_shuffle_epi8(v0, _mm_loadu_si128(&m[4])),
+					_mm_shuffle_epi8(v1, _mm_loadu_si128(&m[5]))),
+				_mm_shuffle_epi8(v2, _mm_loadu_si128(&m[6])));
+			__m128i o2 = _mm_or_si128(
+				_mm_shuffle_epi8(v1, _mm_loadu_si128(&m[9])),
+				_mm_shuffle_epi8(v2, _mm_loadu_si128(&m[10])));
+
+			_mm_storeu_si128((__m128i *) (dst + 0), o0);
+			_mm_storeu_si128((__m128i *) (dst + 16), o1);
+			_mm_storeu_si128((__m128i *) (dst + 32), o2);
+			src += 48;
+			dst += 48;
+		}
+	}
+
+	convert_c_generic(conv, src, dst, width - x);
+}
+
+// --- AVX2 kernel (4 bytes per pixel only) ---
+// pshufb works inside each 128-bit lane, so every lane packs its 4 pixels
+// into 12 bytes and vpermd then closes the gap between the two lanes. The
+// 32-byte store leaves 8 bytes of garbage that the next iteration overwrites,
+// which is why the loop stops while at least 11 pixels remain.
+__attribute__((target("avx2"))) static void
+convert_avx2 (const GstGeminiRowConverter *conv, const guint8 *src, guint8 *dst, gint width) {
+	const __m256i shuf = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *) conv->lane_shuffle));
+	const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	gint x = 0;
+
+	for (; x + 11 <= width; x += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) src);
+		v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuf), perm);
+		_mm256_storeu_si256((__m256i *) dst, v);
+		src += 32;
+		dst += 24;
+	}
+
+	convert_c_generic(conv, src, dst, width - x);
+}
+
+// --- Deinterleave kernels ---
+// Even bytes are masked out of each 16-bit lane, odd bytes shifted down,
+// then both halves are narrowed back to bytes with packus. Plain SSE2.
+__attribute__((target("sse2"))) static void
+deinterleave_sse2 (const guint8 *src, guint8 *even, guint8 *odd, gint n) {
+	const __m128i lo_mask = _mm_set1_epi16(0x00ff);
+	gint x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *) (src + 2 * x));
+		__m128i v1 = _mm_loadu_si128((const __m128i *) (src + 2 * x + 16));
+		__m128i e = _mm_packus_epi16(_mm_and_si128(v0, lo_mask), _mm_and_si128(v1, lo_mask));
+		__m128i o = _mm_packus_epi16(_mm_srli_epi16(v0, 8), _mm_srli_epi16(v1, 8));
+		_mm_storeu_si128((__m128i *) (even + x), e);
+		_mm_storeu_si128((__m128i *) (odd + x), o);
+	}
+
+	deinterleave_c(src + 2 * x, even + x, odd + x, n - x);
+}
+
+// Same as SSE2, packus interleaves the two 128-bit lanes so vpermq restores order
+__attribute__((target("avx2"))) static void
+deinterleave_avx2 (const guint8 *src, guint8 *even, guint8 *odd, gint n) {
+	const __m256i lo_mask = _mm256_set1_epi16(0x00ff);
+	gint x = 0;
+
+	for (; x + 32 <= n; x += 32) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *) (src + 2 * x));
+		__m256i v1 = _mm256_loadu_si256((const __m256i *) (src + 2 * x + 32));
+		__m256i e = _mm256_packus_epi16(_mm256_and_si256(v0, lo_mask), _mm256_and_si256(v1, lo_mask));
+		__m256i o = _mm256_packus_epi16(_mm256_srli_epi16(v0, 8), _mm256_srli_epi16(v1, 8));
+		_mm256_storeu_si256((__m256i *) (even + x), _mm256_permute4x64_epi64(e, 0xd8));
+		_mm256_storeu_si256((__m256i *) (odd + x), _mm256_permute4x64_epi64(o, 0xd8));
+	}
+
+	deinterleave_sse2(src + 2 * x, even + x, odd + x, n - x);
+}
+
+// --- Accumulate kernels ---
+// Bytes are zero-extended to 16 bits and added, 16 (SSE2) or 32 (AVX2) per step
+__attribute__((target("sse2"))) static void
+accumulate_sse2 (guint16 *acc, const guint8 *src, gint n) {
+	const __m128i zero = _mm_setzero_si128();
+	gint x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + x));
+		__m128i a0 = _mm_loadu_si128((const __m128i *) (acc + x));
+		__m128i a1 = _mm_loadu_si128((const __m128i *) (acc + x + 8));
+		_mm_storeu_si128((__m128i *) (acc + x), _mm_add_epi16(a0, _mm_unpacklo_epi8(v, zero)));
+		_mm_storeu_si128((__m128i *) (acc + x + 8), _mm_add_epi16(a1, _mm_unpackhi_epi8(v, zero)));
+	}
+
+	accumulate_c(acc + x, src + x, n - x);
+}
+
+__attribute__((target("avx2"))) static void
+accumulate_avx2 (guint16 *acc, const guint8 *src, gint n) {
+	gint x = 0;
+
+	for (; x + 32 <= n; x += 32) {
+		__m256i v0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + x)));
+		__m256i v1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + x + 16)));
+		__m256i a0 = _mm256_loadu_si256((const __m256i *) (acc + x));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *) (acc + x + 16));
+		_mm256_storeu_si256((__m256i *) (acc + x), _mm256_add_epi16(a0, v0));
+		_mm256_storeu_si256((__m256i *) (acc + x + 16), _mm256_add_epi16(a1, v1));
+	}
+
+	accumulate_sse2(acc + x, src + x, n - x);
+}
+
+// --- Sum of absolute differences ---
+// psadbw leaves the sums of each group of 8 byte differences in 64-bit lanes
+__attribute__((target("sse2"))) static guint64
+sad_sse2 (const guint8 *a, const guint8 *b, gsize n) {
+	__m128i acc = _mm_setzero_si128();
+	gsize i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+
+	guint64 lanes[2];
+	_mm_storeu_si128((__m128i *) lanes, acc);
+	return lanes[0] + lanes[1] + sad_c(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) static guint64
+sad_avx2 (const guint8 *a, const guint8 *b, gsize n) {
+	__m256i acc = _mm256_setzero_si256();
+	gsize i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *) (b + i));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+	}
+
+	guint64 lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, acc);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sad_sse2(a + i, b + i, n - i);
+}
+
+// --- Base64 ---
+// W. Mula's method: each 3-byte group is spread over a 32-bit lane as
+// [b1 b0 b2 b1], two multiplies move the four 6-bit fields into separate
+// bytes, and a pshufb lookup adds the offset of the alphabet range each
+// index falls into ('A', 'a' - 26, '0' - 52, '+' - 62 or '/' - 63).
+#define BASE64_SPREAD_MASK 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+#define BASE64_OFFSET_LUT 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, \
+	'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0
+
+__attribute__((target("ssse3"))) static inline __m128i
+base64_ascii_ssse3 (__m128i in) {
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	const __m128i idx = _mm_or_si128(t1, t3);
+
+	// 0..25 -> 13, 26..51 -> 0, 52..63 -> 1..12
+	__m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+	return _mm_add_epi8(idx, _mm_shuffle_epi8(_mm_setr_epi8(BASE64_OFFSET_LUT), range));
+}
+
+// 12 input bytes per iteration, the 16-byte load needs 4 more readable bytes
+__attribute__((target("ssse3"))) static void
+base64_encode_ssse3 (const guint8 *src, gsize len, gchar *dst) {
+	const __m128i spread = _mm_setr_epi8(BASE64_SPREAD_MASK);
+
+	for (; len >= 16; len -= 12, src += 12, dst += 16) {
+		const __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) src), spread);
+		_mm_storeu_si128((__m128i *) dst, base64_ascii_ssse3(in));
+	}
+
+	base64_encode_c(src, len, dst);
+}
+
+__attribute__((target("avx2"))) static void
+base64_encode_avx2 (const guint8 *src, gsize len, gchar *dst) {
+	const __m256i spread = _mm256_setr_epi8(BASE64_SPREAD_MASK, BASE64_SPREAD_MASK);
+	const __m256i lut = _mm256_setr_epi8(BASE64_OFFSET_LUT, BASE64_OFFSET_LUT);
+
+	// 24 input bytes per iteration, 12 in each 128-bit lane
+	for (; len >= 28; len -= 24, src += 24, dst += 32) {
+		__m256i in = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) src)),
+			_mm_loadu_si128((const __m128i *) (src + 12)), 1);
+		in = _mm256_shuffle_epi8(in, spread);
+
+		const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+		const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+		const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		const __m256i idx = _mm256_or_si256(t1, t3);
+
+		__m256i range = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+		range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+		_mm256_storeu_si256((__m256i *) dst, _mm256_add_epi8(idx, _mm256_shuffle_epi8(lut, range)));
+	}
+
+	base64_encode_ssse3(src, len, dst);
+}
+#endif /* GEMINI_HAVE_X86_KERNELS */
+
+#ifdef GEMINI_HAVE_NEON_KERNELS
+// --- NEON kernel ---
+// vld3/vld4 de-interleave 16 pixels into planes, vst3 re-interleaves as RGB.
+static void
+convert_neon (const GstGeminiRowConverter *conv, const guint8 *src, guint8 *dst, gint width) {
+	const guint8 r = conv->offsets[0], g = conv->offsets[1], b = conv->offsets[2];
+	gint x = 0;
+
+	if (conv->src_pstride == 4) {
+		for (; x + 16 <= width; x += 16) {
+			uint8x16x4_t v = vld4q_u8(src);
+			uint8x16x3_t o;
+			o.val[0] = v.val[r];
+			o.val[1] = v.val[g];
+			o.val[2] = v.val[b];
+			vst3q_u8(dst, o);
+			src += 64;
+			dst += 48;
+		}
+	} else {
+		for (; x + 16 <= width; x += 16) {
+			uint8x16x3_t v = vld3q_u8(src);
+			uint8x16x3_t o;
+			o.val[0] = v.val[r];
+			o.val[1] = v.val[g];
+			o.val[2] = v.val[b];
+			vst3q_u8(dst, o);
+			src += 48;
+			dst += 48;
+		}
+	}
+
+	convert_c_generic(conv, src, dst, width - x);
+}
+
+static void
+deinterleave_neon (const guint8 *src, guint8 *even, guint8 *odd, gint n) {
+	gint x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		uint8x16x2_t v = vld2q_u8(src + 2 * x);
+		vst1q_u8(even + x, v.val[0]);
+		vst1q_u8(odd + x, v.val[1]);
+	}
+
+	deinterleave_c(src + 2 * x, even + x, odd + x, n - x);
+}
+
+static void
+accumulate_neon (guint16 *acc, const guint8 *src, gint n) {
+	gint x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		uint8x16_t v = vld1q_u8(src + x);
+		vst1q_u16(acc + x, vaddw_u8(vld1q_u16(acc + x), vget_low_u8(v)));
+		vst1q_u16(acc + x + 8, vaddw_u8(vld1q_u16(acc + x + 8), vget_high_u8(v)));
+	}
+
+	accumulate_c(acc + x, src + x, n - x);
+}
+
+// Differences are widened and summed pairwise into 16-bit lanes, which
+// hold the sums of 128 blocks before they are folded into 32 bits
+static guint64
+sad_neon (const guint8 *a, const guint8 *b, gsize n) {
+	guint64 sum = 0;
+	gsize i = 0;
+
+	while (i + 16 <= n) {
+		uint16x8_t acc = vdupq_n_u16(0);
+		for (gint k = 0; k < 128 && i + 16 <= n; k++, i += 16) {
+			acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+		}
+		uint64x2_t halves = vpaddlq_u32(vpaddlq_u16(acc));
+		sum += vgetq_lane_u64(halves, 0) + vgetq_lane_u64(halves, 1);
+	}
+
+	return sum + sad_c(a + i, b + i, n - i);
+}
+
+// vld3 splits 16 groups into their three bytes, the four 6-bit indices are
+// shifted out and turned into ASCII by adding a per-range offset
+static void
+base64_encode_neon (const guint8 *src, gsize len, gchar *dst) {
+	const uint8x16_t mask = vdupq_n_u8(0x3F);
+
+	for (; len >= 48; len -= 48, src += 48, dst += 64) {
+		const uint8x16x3_t in = vld3q_u8(src);
+		uint8x16x4_t out;
+
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4), vshlq_n_u8(in.val[0], 4)), mask);
+		out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6), vshlq_n_u8(in.val[1], 2)), mask);
+		out.val[3] = vandq_u8(in.val[2], mask);
+
+		for (gint k = 0; k < 4; k++) {
+			const uint8x16_t idx = out.val[k];
+			// 'A', then + 6 for 'a' - 26, - 75 for '0' - 52, - 15 for '+', + 3 for '/'
+			uint8x16_t off = vdupq_n_u8('A');
+			off = vaddq_u8(off, vandq_u8(vcgeq_u8(idx, vdupq_n_u8(26)), vdupq_n_u8(6)));
+			off = vsubq_u8(off, vandq_u8(vcgeq_u8(idx, vdupq_n_u8(52)), vdupq_n_u8(75)));
+			off = vsubq_u8(off, vandq_u8(vcgeq_u8(idx, vdupq_n_u8(62)), vdupq_n_u8(15)));
+			off = vaddq_u8(off, vandq_u8(vceqq_u8(idx, vdupq_n_u8(63)), vdupq_n_u8(3)));
+			out.val[k] = vaddq_u8(idx, off);
+		}
+		vst4q_u8((guint8 *) dst, out);
+	}
+
+	base64_encode_c(src, len, dst);
+}
+#endif /* GEMINI_HAVE_NEON_KERNELS */
+
+// --- Runtime CPU dispatch ---
+typedef enum {
+	GEMINI_CPU_C,
+	GEMINI_CPU_SSSE3,
+	GEMINI_CPU_AVX2,
+	GEMINI_CPU_NEON
+} GeminiCpuImpl;
+
+static GeminiCpuImpl
+gemini_detect_cpu (void) {
+	static gsize cpu_impl = 0;
+
+	if (g_once_init_enter (&cpu_impl)) {
+		GeminiCpuImpl impl = GEMINI_CPU_C;
+#if defined(GEMINI_HAVE_X86_KERNELS)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			impl = GEMINI_CPU_AVX2;
+		} else if (__builtin_cpu_supports("ssse3")) {
+			impl = GEMINI_CPU_SSSE3;
+		}
+#elif defined(GEMINI_HAVE_NEON_KERNELS)
+		impl = GEMINI_CPU_NEON;
+#endif
+		// g_once_init_leave() does not accept 0, store impl + 1
+		g_once_init_leave (&cpu_impl, impl + 1);
+	}
+	return (GeminiCpuImpl) (cpu_impl - 1);
+}
+
+const gchar *
+gst_gemini_convert_get_cpu_impl (void) {
+	switch (gemini_detect_cpu()) {
+		case GEMINI_CPU_AVX2: return "avx2";
+		case GEMINI_CPU_SSSE3: return "ssse3";
+		case GEMINI_CPU_NEON: return "neon";
+		default: return "c";
+	}
+}
+
+static void
+gemini_build_shuffle_masks (GstGeminiRowConverter *conv) {
+	// Everything that is not explicitly gathered is zeroed (high bit set)
+	memset(conv->shuffle, 0x80, sizeof(conv->shuffle));
+	memset(conv->lane_shuffle, 0x80, sizeof(conv->lane_shuffle));
+
+	for (guint o = 0; o < 48; o++) {
+		guint s = (o / 3) * conv->src_pstride + conv->offsets[o % 3];
+		conv->shuffle[o / 16][s / 16][o % 16] = s % 16;
+	}
+	for (guint o = 0; o < 12; o++) {
+		conv->lane_shuffle[o] = (o / 3) * 4 + conv->offsets[o % 3];
+	}
+}
+
+gboolean
+gst_gemini_row_converter_init (GstGeminiRowConverter *conv, GstVideoFormat format) {
+	GstGeminiRowConvertFunc c_func;
+	GeminiCpuImpl cpu = gemini_detect_cpu();
+
+	memset(conv, 0, sizeof(*conv));
+	conv->format = format;
+	conv->layout = GST_GEMINI_LAYOUT_RGB;
+
+	switch (cpu) {
+#ifdef GEMINI_HAVE_X86_KERNELS
+		case GEMINI_CPU_AVX2:
+			conv->deinterleave = deinterleave_avx2;
+			break;
+		case GEMINI_CPU_SSSE3:
+			conv->deinterleave = deinterleave_sse2;
+			break;
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+		case GEMINI_CPU_NEON:
+			conv->deinterleave = deinterleave_neon;
+			break;
+#endif
+		default:
+#if defined(__x86_64__)
+			// SSE2 is part of the x86-64 baseline
+			conv->deinterleave = deinterleave_sse2;
+#else
+			conv->deinterleave = deinterleave_c;
+#endif
+			break;
+	}
+
+	switch (format) {
+		case GST_VIDEO_FORMAT_I420:
+		case GST_VIDEO_FORMAT_YV12:
+			conv->layout = GST_GEMINI_LAYOUT_PLANAR;
+			conv->v_sub = 2;
+			break;
+		case GST_VIDEO_FORMAT_Y42B:
+			// Not negotiated, produced by the scaler from packed 4:2:2 input
+			conv->layout = GST_GEMINI_LAYOUT_PLANAR;
+			conv->v_sub = 1;
+			break;
+		case GST_VIDEO_FORMAT_NV12:
+		case GST_VIDEO_FORMAT_NV21:
+			conv->layout = GST_GEMINI_LAYOUT_SEMI_PLANAR;
+			conv->v_sub = 2;
+			break;
+		case GST_VIDEO_FORMAT_YUY2:
+		case GST_VIDEO_FORMAT_UYVY:
+		case GST_VIDEO_FORMAT_YVYU:
+			conv->layout = GST_GEMINI_LAYOUT_PACKED_422;
+			conv->v_sub = 1;
+			break;
+		default:
+			break;
+	}
+
+	if (conv->layout != GST_GEMINI_LAYOUT_RGB) {
+		conv->func = convert_c_copy; // Never called for YUV
+		conv->impl = "yuv";
+		return TRUE;
+	}
+
+	switch (format) {
+		case GST_VIDEO_FORMAT_RGB:
+			conv->src_pstride = 3;
+			conv->offsets[0] = 0; conv->offsets[1] = 1; conv->offsets[2] = 2;
+			conv->passthrough = TRUE;
+			c_func = convert_c_copy;
+			break;
+		case GST_VIDEO_FORMAT_BGR:
+			conv->src_pstride = 3;
+			conv->offsets[0] = 2; conv->offsets[1] = 1; conv->offsets[2] = 0;
+			c_func = convert_c_bgr;
+			break;
+		case GST_VIDEO_FORMAT_RGBA:
+		case GST_VIDEO_FORMAT_RGBx:
+			conv->src_pstride = 4;
+			conv->offsets[0] = 0; conv->offsets[1] = 1; conv->offsets[2] = 2;
+			c_func = convert_c_rgbx;
+			break;
+		case GST_VIDEO_FORMAT_BGRA:
+		case GST_VIDEO_FORMAT_BGRx:
+			conv->src_pstride = 4;
+			conv->offsets[0] = 2; conv->offsets[1] = 1; conv->offsets[2] = 0;
+			c_func = convert_c_bgrx;
+			break;
+		case GST_VIDEO_FORMAT_ARGB:
+		case GST_VIDEO_FORMAT_xRGB:
+			conv->src_pstride = 4;
+			conv->offsets[0] = 1; conv->offsets[1] = 2; conv->offsets[2] = 3;
+			c_func = convert_c_xrgb;
+			break;
+		case GST_VIDEO_FORMAT_ABGR:
+		case GST_VIDEO_FORMAT_xBGR:
+			conv->src_pstride = 4;
+			conv->offsets[0] = 3; conv->offsets[1] = 2; conv->offsets[2] = 1;
+			c_func = convert_c_xbgr;
+			break;
+		default:
+			return FALSE;
+	}
+
+	gemini_build_shuffle_masks(conv);
+
+	conv->func = c_func;
+	conv->impl = "c";
+	if (conv->passthrough) {
+		return TRUE;
+	}
+
+	switch (cpu) {
+#ifdef GEMINI_HAVE_X86_KERNELS
+		case GEMINI_CPU_AVX2:
+			if (conv->src_pstride == 4) {
+				conv->func = convert_avx2;
+				conv->impl = "avx2";
+				break;
+			}
+			// No AVX2 kernel for 3-byte pixels, SSSE3 is always present with AVX2
+			/* fall through */
+		case GEMINI_CPU_SSSE3:
+			conv->func = convert_ssse3;
+			conv->impl = "ssse3";
+			break;
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+		case GEMINI_CPU_NEON:
+			conv->func = convert_neon;
+			conv->impl = "neon";
+			break;
+#endif
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
+// --- Box downscaler ---
+void
+gst_gemini_scaler_init (
+	GstGeminiScaler *scaler,
+	gint src_width,
+	gint src_height,
+	gint dst_width,
+	gint dst_height,
+	gint channels
+) {
+	g_return_if_fail(dst_width > 0 && dst_width <= src_width);
+	g_return_if_fail(dst_height > 0 && dst_height <= src_height);
+	g_return_if_fail(channels > 0 && channels <= 4);
+
+	gint *x_edges = scaler->x_edges;
+	guint16 *acc = scaler->acc;
+	gsize x_edges_size = scaler->x_edges_size;
+	gsize acc_size = scaler->acc_size;
+
+	memset(scaler, 0, sizeof(*scaler));
+	scaler->src_width = src_width;
+	scaler->src_height = src_height;
+	scaler->dst_width = dst_width;
+	scaler->dst_height = dst_height;
+	scaler->channels = channels;
+
+	// A 16-bit sum holds 257 rows of 255, thin out taller boxes instead of
+	// widening the accumulators. Only matters for extreme ratios.
+	gint max_rows = (src_height + dst_height - 1) / dst_height;
+	scaler->row_step = (max_rows + 255) / 256;
+
+	scaler->min_cols = src_width / dst_width;
+	if (x_edges_size < (gsize) dst_width + 1) {
+		g_free(x_edges);
+		x_edges_size = (gsize) dst_width + 1;
+		x_edges = g_new(gint, x_edges_size);
+	}
+	if (acc_size < (gsize) src_width * channels) {
+		g_free(acc);
+		acc_size = (gsize) src_width * channels;
+		acc = g_new(guint16, acc_size);
+	}
+	scaler->x_edges = x_edges;
+	scaler->x_edges_size = x_edges_size;
+	scaler->acc = acc;
+	scaler->acc_size = acc_size;
+	for (gint x = 0; x <= dst_width; x++) {
+		scaler->x_edges[x] = (gint) (((gint64) x * src_width) / dst_width);
+	}
+	// Zeroed by gst_gemini_scaler_reset() before every frame
+
+	switch (gemini_detect_cpu()) {
+#ifdef GEMINI_HAVE_X86_KERNELS
+		case GEMINI_CPU_AVX2:
+			scaler->accumulate = accumulate_avx2;
+			break;
+		case GEMINI_CPU_SSSE3:
+			scaler->accumulate = accumulate_sse2;
+			break;
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+		case GEMINI_CPU_NEON:
+			scaler->accumulate = accumulate_neon;
+			break;
+#endif
+		default:
+#if defined(__x86_64__)
+			scaler->accumulate = accumulate_sse2;
+#else
+			scaler->accumulate = accumulate_c;
+#endif
+			break;
+	}
+}
+
+void
+gst_gemini_scaler_clear (GstGeminiScaler *scaler) {
+	g_free(scaler->x_edges);
+	g_free(scaler->acc);
+	memset(scaler, 0, sizeof(*scaler));
+}
+
+void
+gst_gemini_scaler_reset (GstGeminiScaler *scaler, guint8 *dst, gint dst_stride) {
+	scaler->dst = dst;
+	scaler->dst_stride = dst_stride;
+	scaler->src_y = 0;
+	scaler->dst_y = 0;
+	scaler->acc_rows = 0;
+	memset(scaler->acc, 0, (gsize) scaler->src_width * scaler->channels * sizeof(guint16));
+}
+
+// First source row covered by destination row y
+static inline gint
+scaler_row_edge (const GstGeminiScaler *scaler, gint y) {
+	return (gint) (((gint64) y * scaler->src_height) / scaler->dst_height);
+}
+
+// Sums one box of column sums per channel and scales it by the reciprocal
+// of its area. Inlined with a constant channel count so the loops unroll.
+static inline void
+scaler_emit_box (const guint16 *a, gint n, gint ch, guint64 recip, guint8 *dst) {
+	guint32 sum[4] = { 0, 0, 0, 0 };
+
+	for (gint i = 0; i < n; i++, a += ch) {
+		for (gint c = 0; c < ch; c++) {
+			sum[c] += a[c];
+		}
+	}
+	for (gint c = 0; c < ch; c++) {
+		dst[c] = (guint8) MIN(((guint64) sum[c] * recip + (G_GUINT64_CONSTANT(1) << 31)) >> 32, 255);
+	}
+}
+
+#define DEFINE_EMIT_ROW(name, CH)                                                         \
+	static void                                                                           \
+	name (GstGeminiScaler *scaler, guint8 *dst, gint ch) {                                \
+		for (gint x = 0; x < scaler->dst_width; x++) {                                    \
+			const gint x0 = scaler->x_edges[x], x1 = scaler->x_edges[x + 1];              \
+			scaler_emit_box(scaler->acc + (gsize) x0 * (CH), x1 - x0, (CH),               \
+				scaler->recip[x1 - x0 - scaler->min_cols], dst + x * (CH));               \
+		}                                                                                 \
+	}
+
+DEFINE_EMIT_ROW (scaler_emit_row_1, 1)
+DEFINE_EMIT_ROW (scaler_emit_row_3, 3)
+DEFINE_EMIT_ROW (scaler_emit_row_n, ch)
+
+// Collapses the column sums into one destination row
+static void
+scaler_emit_row (GstGeminiScaler *scaler) {
+	guint8 *dst = scaler->dst + (gsize) scaler->dst_y * scaler->dst_stride;
+
+	// Boxes are min_cols or min_cols + 1 wide, so a 32.32 fixed point
+	// reciprocal per width replaces a division per pixel
+	for (gint w = scaler->min_cols; w <= scaler->min_cols + 1; w++) {
+		const guint32 count = (guint32) w * scaler->acc_rows;
+		scaler->recip[w - scaler->min_cols] = ((G_GUINT64_CONSTANT(1) << 32) + count / 2) / count;
+	}
+
+	switch (scaler->channels) {
+		case 1:
+			scaler_emit_row_1(scaler, dst, 1);
+			break;
+		case 3:
+			scaler_emit_row_3(scaler, dst, 3);
+			break;
+		default:
+			scaler_emit_row_n(scaler, dst, scaler->channels);
+			break;
+	}
+}
+
+void
+gst_gemini_scaler_push_row (GstGeminiScaler *scaler, const guint8 *src) {
+	if (scaler->dst_y >= scaler->dst_height) {
+		return;
+	}
+
+	const gint y0 = scaler_row_edge(scaler, scaler->dst_y);
+	const gint y1 = scaler_row_edge(scaler, scaler->dst_y + 1);
+
+	if ((scaler->src_y - y0) % scaler->row_step == 0) {
+		scaler->accumulate(scaler->acc, src, scaler->src_width * scaler->channels);
+		scaler->acc_rows++;
+	}
+	scaler->src_y++;
+
+	if (scaler->src_y >= y1) {
+		scaler_emit_row(scaler);
+		memset(scaler->acc, 0, (gsize) scaler->src_width * scaler->channels * sizeof(guint16));
+		scaler->acc_rows = 0;
+		scaler->dst_y++;
+	}
+}
+
+void
+gst_gemini_base64_encode (const guint8 *src, gsize len, gchar *dst) {
+	switch (gemini_detect_cpu()) {
+#ifdef GEMINI_HAVE_X86_KERNELS
+		case GEMINI_CPU_AVX2:
+			base64_encode_avx2(src, len, dst);
+			return;
+		case GEMINI_CPU_SSSE3:
+			base64_encode_ssse3(src, len, dst);
+			return;
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+		case GEMINI_CPU_NEON:
+			base64_encode_neon(src, len, dst);
+			return;
+#endif
+		default:
+			base64_encode_c(src, len, dst);
+			return;
+	}
+}
+
+// --- Scene thumbnail ---
+// 4 x 4 samples per cell at the centres of an even grid over the frame
+#define THUMBNAIL_SAMPLES 4
+
+gboolean
+gst_gemini_thumbnail (const GstVideoFrame *frame, guint8 *thumb) {
+	const GstVideoFormatInfo *finfo = frame->info.finfo;
+	const gint width = GST_VIDEO_FRAME_WIDTH(frame);
+	const gint height = GST_VIDEO_FRAME_HEIGHT(frame);
+	const gboolean is_rgb = GST_VIDEO_FORMAT_INFO_IS_RGB(finfo);
+	const gint n_comps = is_rgb ? 3 : 1;
+	const gint cols = GST_GEMINI_THUMBNAIL_WIDTH * THUMBNAIL_SAMPLES;
+	const gint rows = GST_GEMINI_THUMBNAIL_HEIGHT * THUMBNAIL_SAMPLES;
+	const guint8 *data[3];
+	gint stride[3];
+	gint x_offsets[3][GST_GEMINI_THUMBNAIL_WIDTH * THUMBNAIL_SAMPLES];
+
+	for (gint c = 0; c < n_comps; c++) {
+		if (GST_VIDEO_FORMAT_INFO_DEPTH(finfo, c) != 8) {
+			return FALSE;
+		}
+		data[c] = GST_VIDEO_FRAME_COMP_DATA(frame, c);
+		stride[c] = GST_VIDEO_FRAME_COMP_STRIDE(frame, c);
+		// Luma is never subsampled, RGB components neither
+		for (gint x = 0; x < cols; x++) {
+			x_offsets[c][x] = (gint) (((gint64) (2 * x + 1) * width) / (2 * cols)) * 
+				GST_VIDEO_FRAME_COMP_PSTRIDE(frame, c);
+		}
+	}
+
+	for (gint ty = 0; ty < GST_GEMINI_THUMBNAIL_HEIGHT; ty++) {
+		guint sums[GST_GEMINI_THUMBNAIL_WIDTH] = { 0 };
+
+		for (gint sy = 0; sy < THUMBNAIL_SAMPLES; sy++) {
+			const gint y = (gint) (((gint64) (2 * (ty * THUMBNAIL_SAMPLES + sy) + 1) * height) / (2 * rows));
+
+			if (is_rgb) {
+				const guint8 *r = data[0] + (gsize) y * stride[0];
+				const guint8 *g = data[1] + (gsize) y * stride[1];
+				const guint8 *b = data[2] + (gsize) y * stride[2];
+				for (gint x = 0; x < cols; x++) {
+					sums[x / THUMBNAIL_SAMPLES] += r[x_offsets[0][x]] + 2 * g[x_offsets[1][x]] + b[x_offsets[2][x]];
+				}
+			} else {
+				const guint8 *luma = data[0] + (gsize) y * stride[0];
+				for (gint x = 0; x < cols; x++) {
+					sums[x / THUMBNAIL_SAMPLES] += 4 * luma[x_offsets[0][x]];
+				}
+			}
+		}
+		// Every cell summed 16 samples weighted 4 in total
+		for (gint tx = 0; tx < GST_GEMINI_THUMBNAIL_WIDTH; tx++) {
+			thumb[ty * GST_GEMINI_THUMBNAIL_WIDTH + tx] = 
+				(guint8) ((sums[tx] + THUMBNAIL_SAMPLES * THUMBNAIL_SAMPLES * 2) / (THUMBNAIL_SAMPLES * THUMBNAIL_SAMPLES * 4));
+		}
+	}
+	return TRUE;
+}
+
+#define DHASH_COLS 9
+#define DHASH_ROWS 8
+
+guint64
+gst_gemini_dhash (const guint8 *thumb) {
+	guint boxes[DHASH_ROWS][DHASH_COLS];
+	guint64 hash = 0;
+
+	for (gint by = 0; by < DHASH_ROWS; by++) {
+		const gint y0 = by * GST_GEMINI_THUMBNAIL_HEIGHT / DHASH_ROWS;
+		const gint y1 = (by + 1) * GST_GEMINI_THUMBNAIL_HEIGHT / DHASH_ROWS;
+
+		for (gint bx = 0; bx < DHASH_COLS; bx++) {
+			const gint x0 = bx * GST_GEMINI_THUMBNAIL_WIDTH / DHASH_COLS;
+			const gint x1 = (bx + 1) * GST_GEMINI_THUMBNAIL_WIDTH / DHASH_COLS;
+			guint sum = 0;
+
+			for (gint y = y0; y < y1; y++) {
+				for (gint x = x0; x < x1; x++) {
+					sum += thumb[y * GST_GEMINI_THUMBNAIL_WIDTH + x];
+				}
+			}
+			// Boxes differ in size by a column or a row, compare means
+			boxes[by][bx] = sum * 64 / (guint) ((y1 - y0) * (x1 - x0));
+		}
+	}
+	for (gint by = 0; by < DHASH_ROWS; by++) {
+		for (gint bx = 0; bx < DHASH_COLS - 1; bx++) {
+			hash = hash << 1 | (boxes[by][bx] > boxes[by][bx + 1]);
+		}
+	}
+	return hash;
+}
+
+guint64
+gst_gemini_sad (const guint8 *a, const guint8 *b, gsize n) {
+	switch (gemini_detect_cpu()) {
+#ifdef GEMINI_HAVE_X86_KERNELS
+		case GEMINI_CPU_AVX2:
+			return sad_avx2(a, b, n);
+		case GEMINI_CPU_SSSE3:
+			return sad_sse2(a, b, n);
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+		case GEMINI_CPU_NEON:
+			return sad_neon(a, b, n);
+#endif
+		default:
+#if defined(__x86_64__)
+			return sad_sse2(a, b, n);
+#else
+			return sad_c(a, b, n);
+#endif
+	}
+}
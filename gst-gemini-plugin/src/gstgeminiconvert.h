@@ -0,0 +1,133 @@
+#ifndef __GST_GEMINI_CONVERT_H__
+#define __GST_GEMINI_CONVERT_H__
+
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstGeminiRowConverter GstGeminiRowConverter;
+
+// How the input planes map to what libjpeg is fed
+typedef enum {
+	GST_GEMINI_LAYOUT_RGB,          // Packed RGB family, converted to RGB rows
+	GST_GEMINI_LAYOUT_PLANAR,       // I420/YV12/Y42B, planes passed as raw data
+	GST_GEMINI_LAYOUT_SEMI_PLANAR,  // NV12/NV21, interleaved chroma split per row
+	GST_GEMINI_LAYOUT_PACKED_422    // YUY2/UYVY/YVYU, split into 3 planes per row
+} GstGeminiLayout;
+
+typedef void (*GstGeminiRowConvertFunc) (
+	const GstGeminiRowConverter *conv,
+	const guint8 *src,
+	guint8 *dst,
+	gint width
+);
+
+// Splits 2 * n interleaved bytes into n even and n odd bytes
+typedef void (*GstGeminiDeinterleaveFunc) (
+	const guint8 *src,
+	guint8 *even,
+	guint8 *odd,
+	gint n
+);
+
+// Converts one row of a packed RGB-family format to tightly packed RGB,
+// the layout libjpeg expects for JCS_RGB. The kernel is picked once per
+// format (and per CPU) so the encode loop never branches on the format.
+// YUV formats skip the colour conversion entirely and only get the
+// deinterleave kernel needed to hand libjpeg separate Y, Cb and Cr rows.
+struct _GstGeminiRowConverter {
+	GstVideoFormat format;
+	GstGeminiLayout layout;
+	guint v_sub;                // Vertical chroma subsampling of YUV input (1 or 2)
+	GstGeminiDeinterleaveFunc deinterleave;
+	guint src_pstride;          // Bytes per input pixel (3 or 4)
+	guint8 offsets[3];          // Byte offset of R, G and B inside an input pixel
+	gboolean passthrough;       // Input rows are already packed RGB
+	GstGeminiRowConvertFunc func;
+	const gchar *impl;          // Name of the selected kernel, for debugging
+
+	// pshufb control bytes, built once by gst_gemini_row_converter_init():
+	// shuffle[k][j] gathers output vector k from input vector j, lane_shuffle
+	// packs the 4 pixels of a 128-bit lane into its first 12 bytes.
+	guint8 shuffle[3][4][16];
+	guint8 lane_shuffle[16];
+};
+
+gboolean gst_gemini_row_converter_init (GstGeminiRowConverter *conv, GstVideoFormat format);
+
+static inline void
+gst_gemini_row_converter_convert (
+	const GstGeminiRowConverter *conv,
+	const guint8 *src,
+	guint8 *dst,
+	gint width
+) {
+	conv->func (conv, src, dst, width);
+}
+
+// Name of the best instruction set detected at runtime ("avx2", "ssse3", "neon" or "c")
+const gchar *gst_gemini_convert_get_cpu_impl (void);
+
+typedef struct _GstGeminiScaler GstGeminiScaler;
+
+// Adds n bytes to n 16-bit accumulators
+typedef void (*GstGeminiAccumulateFunc) (guint16 *acc, const guint8 *src, gint n);
+
+// Box (area) downscaler for one plane of interleaved 8-bit samples. Source
+// rows are pushed in order and each destination pixel becomes the average of
+// the source pixels it covers. Only the running column sums of the current
+// destination row are kept, so the whole source frame is never buffered.
+struct _GstGeminiScaler {
+	gint src_width, src_height;
+	gint dst_width, dst_height;
+	gint channels;              // Interleaved samples per pixel (up to 4; 3 for RGB, 1 for a Y/Cb/Cr plane)
+	gint row_step;              // Only every row_step-th source row is summed, keeps the sums in 16 bits
+	gint *x_edges;              // dst_width + 1 source column boundaries
+	gint min_cols;              // Narrowest box, every box is min_cols or min_cols + 1 wide
+	guint64 recip[2];           // 2^32 / box area for both widths, refreshed per row
+	guint16 *acc;               // Column sums of the destination row being built
+	GstGeminiAccumulateFunc accumulate;
+	gsize x_edges_size;         // Allocated entries of x_edges and acc, kept across inits
+	gsize acc_size;
+
+	// Per frame state, set by gst_gemini_scaler_reset()
+	guint8 *dst;
+	gint dst_stride;
+	gint src_y;                 // Next source row expected
+	gint dst_y;                 // Destination row being built
+	gint acc_rows;              // Source rows summed into acc so far
+};
+
+// The scaler must be zeroed or cleared before its first init. Initializing
+// it again for other sizes reuses its arrays when they are large enough.
+void gst_gemini_scaler_init (GstGeminiScaler *scaler, gint src_width, gint src_height, gint dst_width, gint dst_height, gint channels);
+void gst_gemini_scaler_clear (GstGeminiScaler *scaler);
+void gst_gemini_scaler_reset (GstGeminiScaler *scaler, guint8 *dst, gint dst_stride);
+void gst_gemini_scaler_push_row (GstGeminiScaler *scaler, const guint8 *src);
+
+// Grid of approximate luma values summarizing a frame for change detection
+#define GST_GEMINI_THUMBNAIL_WIDTH 64
+#define GST_GEMINI_THUMBNAIL_HEIGHT 36
+#define GST_GEMINI_THUMBNAIL_SIZE (GST_GEMINI_THUMBNAIL_WIDTH * GST_GEMINI_THUMBNAIL_HEIGHT)
+
+// Fills thumb with GST_GEMINI_THUMBNAIL_SIZE bytes, each the mean luma of
+// 4 x 4 samples spread over its cell of the frame (R + 2G + B for RGB).
+// Returns FALSE for formats that are not 8 bits per component.
+gboolean gst_gemini_thumbnail (const GstVideoFrame *frame, guint8 *thumb);
+
+// 64-bit difference hash of a thumbnail. It is reduced to 9 x 8 boxes and
+// each bit tells whether a box is brighter than its right neighbour, so
+// similar pictures differ in few bits regardless of exposure.
+guint64 gst_gemini_dhash (const guint8 *thumb);
+
+// Sum of absolute differences of n bytes
+guint64 gst_gemini_sad (const guint8 *a, const guint8 *b, gsize n);
+
+// Standard base64 with padding, writes 4 * ((len + 2) / 3) characters and no
+// terminator. Encoding consecutive pieces whose lengths are multiples of 3
+// gives the same output as encoding the whole buffer at once.
+void gst_gemini_base64_encode (const guint8 *src, gsize len, gchar *dst);
+
+G_END_DECLS
+
+#endif /* __GST_GEMINI_CONVERT_H__ */
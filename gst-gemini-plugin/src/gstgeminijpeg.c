@@ -0,0 +1,303 @@
+// src/gstgeminijpeg.c
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgeminijpeg.h"
+#include <string.h>
+#include <jerror.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_gemini_vision_debug_category);
+#define GST_CAT_DEFAULT gst_gemini_vision_debug_category
+
+// Smallest pooled output buffer, and the granularity pool sizes are rounded to
+#define GEMINI_JPEG_MIN_BUFFER_SIZE 16384
+#define GEMINI_JPEG_BUFFER_ALIGN 4096
+
+// --- libjpeg error manager logging to the debug category ---
+// The default one prints to stderr and calls exit(), which must not happen in
+// the encoder or stripe threads of a running pipeline
+
+// Logs the error and returns to GST_GEMINI_JPEG_ENCODER_CATCH()
+static void
+jpeg_error_exit(j_common_ptr cinfo) {
+	GstGeminiJpegEncoder *enc = (GstGeminiJpegEncoder *) cinfo->client_data;
+	char message[JMSG_LENGTH_MAX];
+
+	(*cinfo->err->format_message)(cinfo, message);
+	GST_ERROR("libjpeg failed: %s", message);
+	longjmp(enc->jump, 1);
+}
+
+static void
+jpeg_output_message(j_common_ptr cinfo) {
+	char message[JMSG_LENGTH_MAX];
+
+	(*cinfo->err->format_message)(cinfo, message);
+	GST_WARNING("libjpeg: %s", message);
+}
+
+// --- libjpeg destination manager writing into a mapped GstBuffer ---
+static void
+jpeg_init_destination(j_compress_ptr cinfo) {
+	GstGeminiJpegEncoder *enc = (GstGeminiJpegEncoder *) cinfo->client_data;
+
+	cinfo->dest->next_output_byte = enc->out_map.data;
+	cinfo->dest->free_in_buffer = enc->out_map.size;
+}
+
+// Only reached when a frame is larger than the pooled buffer, the data moves
+// to a buffer twice the size and the next frame gets a bigger pool
+static boolean
+jpeg_empty_output_buffer(j_compress_ptr cinfo) {
+	GstGeminiJpegEncoder *enc = (GstGeminiJpegEncoder *) cinfo->client_data;
+	gsize used = enc->out_map.size;
+	GstBuffer *bigger = gst_buffer_new_allocate(NULL, used * 2, NULL);
+	GstMapInfo bigger_map;
+
+	if (!bigger || !gst_buffer_map(bigger, &bigger_map, GST_MAP_WRITE)) {
+		if (bigger) gst_buffer_unref(bigger);
+		ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+		return FALSE;
+	}
+
+	memcpy(bigger_map.data, enc->out_map.data, used);
+	gst_buffer_unmap(enc->out, &enc->out_map);
+	gst_buffer_unref(enc->out);
+	enc->out = bigger;
+	enc->out_map = bigger_map;
+
+	cinfo->dest->next_output_byte = enc->out_map.data + used;
+	cinfo->dest->free_in_buffer = enc->out_map.size - used;
+	return TRUE;
+}
+
+static void
+jpeg_term_destination(j_compress_ptr cinfo) {
+	// The final size is read from free_in_buffer in gst_gemini_jpeg_encoder_finish()
+}
+
+void
+gst_gemini_jpeg_encoder_init (GstGeminiJpegEncoder *enc) {
+	memset(enc, 0, sizeof(*enc));
+}
+
+void
+gst_gemini_jpeg_encoder_clear (GstGeminiJpegEncoder *enc) {
+	if (enc->out) {
+		gst_gemini_jpeg_encoder_abort(enc);
+	}
+	if (enc->initialized) {
+		jpeg_destroy_compress(&enc->cinfo);
+	}
+	if (enc->pool) {
+		gst_buffer_pool_set_active(enc->pool, FALSE);
+		gst_object_unref(enc->pool);
+	}
+	g_free(enc->scratch);
+	memset(enc, 0, sizeof(*enc));
+}
+
+// Recreates the pool when the previous frame did not fit, or when frames
+// became much smaller than the pooled buffers. Buffers still in flight
+// keep the old pool alive until they are released.
+static void
+ensure_output_pool(GstGeminiJpegEncoder *enc, gsize size_hint) {
+	gsize wanted = enc->last_size ? enc->last_size + enc->last_size / 4 : size_hint;
+	wanted = MAX(GST_ROUND_UP_N(wanted, GEMINI_JPEG_BUFFER_ALIGN), GEMINI_JPEG_MIN_BUFFER_SIZE);
+
+	if (enc->pool && enc->last_size <= enc->pool_size && wanted >= enc->pool_size / 4) {
+		return;
+	}
+
+	if (enc->pool) {
+		gst_buffer_pool_set_active(enc->pool, FALSE);
+		gst_object_unref(enc->pool);
+	}
+
+	enc->pool = gst_buffer_pool_new();
+	GstStructure *config = gst_buffer_pool_get_config(enc->pool);
+	gst_buffer_pool_config_set_params(config, NULL, (guint) wanted, 2, 0);
+	if (!gst_buffer_pool_set_config(enc->pool, config) || !gst_buffer_pool_set_active(enc->pool, TRUE)) {
+		GST_WARNING("Failed to configure JPEG output pool, falling back to plain allocations");
+		gst_object_unref(enc->pool);
+		enc->pool = NULL;
+	}
+	enc->pool_size = wanted;
+
+	GST_DEBUG("JPEG output buffers resized to %" G_GSIZE_FORMAT " bytes (previous frame %" G_GSIZE_FORMAT ")",
+		wanted, enc->last_size);
+}
+
+j_compress_ptr
+gst_gemini_jpeg_encoder_begin (GstGeminiJpegEncoder *enc, gsize size_hint) {
+	g_return_val_if_fail(enc->out == NULL, NULL);
+
+	if (!enc->initialized) {
+		enc->cinfo.err = jpeg_std_error(&enc->jerr);
+		enc->jerr.error_exit = jpeg_error_exit;
+		enc->jerr.output_message = jpeg_output_message;
+		// Kept by jpeg_create_compress(), the error manager needs it
+		enc->cinfo.client_data = enc;
+		if (setjmp(enc->jump)) {
+			jpeg_destroy_compress(&enc->cinfo);
+			return NULL;
+		}
+		jpeg_create_compress(&enc->cinfo);
+
+		enc->dest.init_destination = jpeg_init_destination;
+		enc->dest.empty_output_buffer = jpeg_empty_output_buffer;
+		enc->dest.term_destination = jpeg_term_destination;
+		enc->cinfo.dest = &enc->dest;
+		enc->initialized = TRUE;
+	}
+
+	ensure_output_pool(enc, size_hint);
+
+	if (!enc->pool || gst_buffer_pool_acquire_buffer(enc->pool, &enc->out, NULL) != GST_FLOW_OK) {
+		enc->out = gst_buffer_new_allocate(NULL, enc->pool_size, NULL);
+	}
+	if (!enc->out || !gst_buffer_map(enc->out, &enc->out_map, GST_MAP_WRITE)) {
+		GST_ERROR("Failed to get a JPEG output buffer of %" G_GSIZE_FORMAT " bytes", enc->pool_size);
+		if (enc->out) gst_buffer_unref(enc->out);
+		enc->out = NULL;
+		return NULL;
+	}
+
+	return &enc->cinfo;
+}
+
+GstBuffer *
+gst_gemini_jpeg_encoder_finish (GstGeminiJpegEncoder *enc) {
+	GstBuffer *out;
+	gsize size;
+
+	g_return_val_if_fail(enc->out != NULL, NULL);
+
+	if (setjmp(enc->jump)) {
+		gst_gemini_jpeg_encoder_abort(enc);
+		return NULL;
+	}
+	jpeg_finish_compress(&enc->cinfo);
+
+	size = enc->out_map.size - enc->dest.free_in_buffer;
+	gst_buffer_unmap(enc->out, &enc->out_map);
+	gst_buffer_set_size(enc->out, size);
+	enc->last_size = size;
+
+	out = enc->out;
+	enc->out = NULL;
+	return out;
+}
+
+void
+gst_gemini_jpeg_encoder_abort (GstGeminiJpegEncoder *enc) {
+	if (enc->initialized) {
+		jpeg_abort_compress(&enc->cinfo);
+	}
+	if (enc->out) {
+		gst_buffer_unmap(enc->out, &enc->out_map);
+		gst_buffer_unref(enc->out);
+		enc->out = NULL;
+	}
+}
+
+guint8 *
+gst_gemini_jpeg_encoder_get_scratch (GstGeminiJpegEncoder *enc, gsize size) {
+	if (size > enc->scratch_size) {
+		g_free(enc->scratch);
+		enc->scratch = g_malloc(size);
+		enc->scratch_size = size;
+	}
+	return enc->scratch;
+}
+
+// Walks the marker segments in front of the scan. Returns the offset of the
+// first entropy-coded byte and the offset of the SOF marker, or 0 when the
+// data is not a single-scan baseline JPEG ending in EOI.
+static gsize
+find_scan_data(const guint8 *data, gsize size, gsize *sof_offset) {
+	gsize pos = 2;
+
+	if (size < 4 || data[0] != 0xFF || data[1] != 0xD8 || 
+		data[size - 2] != 0xFF || data[size - 1] != 0xD9) {
+		return 0;
+	}
+
+	*sof_offset = 0;
+	while (pos + 4 <= size && data[pos] == 0xFF) {
+		const guint8 marker = data[pos + 1];
+		const gsize length = GST_READ_UINT16_BE(data + pos + 2);
+
+		if (marker == 0xC0 || marker == 0xC1) {
+			*sof_offset = pos;
+		}
+		pos += 2 + length;
+		if (marker == 0xDA) {
+			return *sof_offset && pos <= size - 2 ? pos : 0;
+		}
+	}
+	return 0;
+}
+
+GstBuffer *
+gst_gemini_jpeg_join_stripes (GstBuffer **stripes, guint n_stripes, guint height) {
+	GstMapInfo *maps = g_newa(GstMapInfo, n_stripes);
+	gsize *scan_start = g_newa(gsize, n_stripes);
+	gsize sof_offset = 0, total, pos;
+	GstBuffer *joined = NULL;
+	GstMapInfo joined_map;
+	guint mapped;
+
+	g_return_val_if_fail(n_stripes > 0 && height <= G_MAXUINT16, NULL);
+
+	// Header of the first stripe, then the entropy-coded data of every stripe
+	// with RST7 in between, then EOI
+	total = 0;
+	for (mapped = 0; mapped < n_stripes; mapped++) {
+		gsize sof;
+
+		if (!gst_buffer_map(stripes[mapped], &maps[mapped], GST_MAP_READ)) {
+			goto done;
+		}
+		scan_start[mapped] = find_scan_data(maps[mapped].data, maps[mapped].size, &sof);
+		if (!scan_start[mapped]) {
+			GST_WARNING("JPEG stripe %u has no parsable scan", mapped);
+			mapped++;
+			goto done;
+		}
+		if (mapped == 0) {
+			sof_offset = sof;
+			total += scan_start[0];
+		}
+		total += maps[mapped].size - 2 - scan_start[mapped] + 2;
+	}
+
+	joined = gst_buffer_new_allocate(NULL, total, NULL);
+	if (!joined || !gst_buffer_map(joined, &joined_map, GST_MAP_WRITE)) {
+		if (joined) gst_buffer_unref(joined);
+		joined = NULL;
+		goto done;
+	}
+
+	memcpy(joined_map.data, maps[0].data, scan_start[0]);
+	// Frame height, after the SOF marker, its length and the sample precision
+	GST_WRITE_UINT16_BE(joined_map.data + sof_offset + 5, height);
+	pos = scan_start[0];
+
+	for (guint i = 0; i < n_stripes; i++) {
+		const gsize scan_size = maps[i].size - 2 - scan_start[i];
+
+		memcpy(joined_map.data + pos, maps[i].data + scan_start[i], scan_size);
+		pos += scan_size;
+		joined_map.data[pos++] = 0xFF;
+		joined_map.data[pos++] = i + 1 < n_stripes ? 0xD7 : 0xD9;
+	}
+	gst_buffer_unmap(joined, &joined_map);
+
+done:
+	for (guint i = 0; i < mapped; i++) {
+		gst_buffer_unmap(stripes[i], &maps[i]);
+	}
+	return joined;
+}
@@ -0,0 +1,69 @@
+#ifndef __GST_GEMINI_JPEG_H__
+#define __GST_GEMINI_JPEG_H__
+
+#include <stdio.h>     // jpeglib.h needs FILE and size_t
+#include <setjmp.h>
+#include <gst/gst.h>
+#include <jpeglib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstGeminiJpegEncoder GstGeminiJpegEncoder;
+
+// A libjpeg compressor that lives as long as the element, writing into
+// pooled GstBuffers. The compressor keeps its quantization and Huffman
+// tables between frames, and the output buffers are sized from the
+// previous frame so the steady state neither reallocates nor copies.
+struct _GstGeminiJpegEncoder {
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	jmp_buf jump;               // Where libjpeg errors return to, see GST_GEMINI_JPEG_ENCODER_CATCH()
+	struct jpeg_destination_mgr dest;
+	gboolean initialized;
+
+	GstBufferPool *pool;
+	gsize pool_size;            // Size of the pooled output buffers
+	gsize last_size;            // Size of the previous JPEG, drives pool_size
+
+	GstBuffer *out;             // Output of the frame being encoded, mapped while encoding
+	GstMapInfo out_map;
+
+	guint8 *scratch;            // Row conversion scratch, grown on demand and kept
+	gsize scratch_size;
+};
+
+void gst_gemini_jpeg_encoder_init (GstGeminiJpegEncoder *enc);
+void gst_gemini_jpeg_encoder_clear (GstGeminiJpegEncoder *enc);
+
+// libjpeg errors are logged and return to the point set with this macro,
+// which must be used in the function making the libjpeg calls, right after
+// gst_gemini_jpeg_encoder_begin(). It evaluates to 0 when the point is set
+// and to non-zero after an error, the frame must then be dropped with
+// gst_gemini_jpeg_encoder_abort().
+#define GST_GEMINI_JPEG_ENCODER_CATCH(enc) setjmp((enc)->jump)
+
+// Acquires an output buffer and returns the compressor with its destination
+// set, ready for parameters and jpeg_start_compress(). size_hint is used for
+// the first frame only, later frames are sized from their predecessor.
+// Returns NULL when the compressor or the buffer cannot be set up.
+j_compress_ptr gst_gemini_jpeg_encoder_begin (GstGeminiJpegEncoder *enc, gsize size_hint);
+
+// Finishes compression and hands over the encoded image, or drops the frame
+// and returns NULL when libjpeg fails
+GstBuffer *gst_gemini_jpeg_encoder_finish (GstGeminiJpegEncoder *enc);
+
+// Drops the frame being encoded, the compressor stays usable
+void gst_gemini_jpeg_encoder_abort (GstGeminiJpegEncoder *enc);
+
+// Returns at least size bytes of scratch memory owned by the encoder
+guint8 *gst_gemini_jpeg_encoder_get_scratch (GstGeminiJpegEncoder *enc, gsize size);
+
+// Joins JPEGs of consecutive horizontal stripes into one image of the given
+// height. The stripes must share their width, parameters and tables, put a
+// restart marker after every MCU row, and all but the last must hold a
+// multiple of 8 MCU rows. Returns NULL when a stripe cannot be parsed.
+GstBuffer *gst_gemini_jpeg_join_stripes (GstBuffer **stripes, guint n_stripes, guint height);
+
+G_END_DECLS
+
+#endif /* __GST_GEMINI_JPEG_H__ */
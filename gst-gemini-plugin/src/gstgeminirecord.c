@@ -0,0 +1,294 @@
+// src/gstgeminirecord.c
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgeminirecord.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_gemini_vision_debug_category);
+#define GST_CAT_DEFAULT gst_gemini_vision_debug_category
+
+// The file starts with this, followed by the records: the key, the length
+// of the response as 32-bit little endian and the response in UTF-8
+#define GEMINI_RECORD_MAGIC "GGVREC01"
+#define GEMINI_RECORD_MAGIC_SIZE 8
+#define GEMINI_RECORD_HEADER_SIZE (GST_GEMINI_RECORD_KEY_SIZE + 4)
+
+struct _GstGeminiRecord {
+	GMutex lock;
+	gchar *path;
+	GMappedFile *mapped;        // Contents when opened, NULL if there were none
+	GHashTable *index;          // Key GBytes to response GBytes, into mapped or owned
+	gint fd;                    // Open for appending, -1 if read-only
+};
+
+static gboolean
+write_all(gint fd, const guint8 *data, gsize size) {
+	while (size > 0) {
+		gssize n = write(fd, data, size);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return FALSE;
+		}
+		data += n;
+		size -= n;
+	}
+	return TRUE;
+}
+
+// Holds off other processes appending to the file, so a partial record at
+// the end is known to be left by a failed write and not one in progress
+static void
+lock_file(gint fd) {
+	while (flock(fd, LOCK_EX) != 0 && errno == EINTR) {
+	}
+}
+
+static void
+unlock_file(gint fd) {
+	flock(fd, LOCK_UN);
+}
+
+// Indexes the records of the mapped file and returns the end of the last
+// complete one
+static gsize
+index_records(GstGeminiRecord *record, const guint8 *data, gsize size) {
+	gsize pos = GEMINI_RECORD_MAGIC_SIZE;
+
+	while (size - pos >= GEMINI_RECORD_HEADER_SIZE) {
+		guint32 len;
+
+		memcpy(&len, data + pos + GST_GEMINI_RECORD_KEY_SIZE, sizeof(len));
+		len = GUINT32_FROM_LE(len);
+		if (size - pos - GEMINI_RECORD_HEADER_SIZE < len) {
+			break;
+		}
+		g_hash_table_replace(
+			record->index,
+			g_bytes_new_static(data + pos, GST_GEMINI_RECORD_KEY_SIZE),
+			g_bytes_new_static(data + pos + GEMINI_RECORD_HEADER_SIZE, len)
+		);
+		pos += GEMINI_RECORD_HEADER_SIZE + len;
+	}
+	return pos;
+}
+
+GstGeminiRecord *
+gst_gemini_record_open (const gchar *path, gboolean writable, GError **error) {
+	GstGeminiRecord *record = g_new0(GstGeminiRecord, 1);
+	gint fd = g_open(path, writable ? O_RDWR | O_CREAT | O_APPEND : O_RDONLY, 0644);
+	gsize size = 0;
+
+	g_mutex_init(&record->lock);
+	record->path = g_strdup(path);
+	record->index = g_hash_table_new_full(
+		g_bytes_hash,
+		g_bytes_equal,
+		(GDestroyNotify) g_bytes_unref,
+		(GDestroyNotify) g_bytes_unref
+	);
+	record->fd = -1;
+
+	if (fd < 0) {
+		gint saved_errno = errno;
+
+		if (!writable && saved_errno == ENOENT) {
+			return record;
+		}
+		g_set_error(
+			error,
+			G_FILE_ERROR,
+			g_file_error_from_errno(saved_errno),
+			"Cannot open %s: %s",
+			path,
+			g_strerror(saved_errno)
+		);
+		gst_gemini_record_close(record);
+		return NULL;
+	}
+
+	if (writable) {
+		lock_file(fd);
+	}
+	record->mapped = g_mapped_file_new_from_fd(fd, FALSE, error);
+	if (!record->mapped) {
+		close(fd);
+		gst_gemini_record_close(record);
+		return NULL;
+	}
+	size = g_mapped_file_get_length(record->mapped);
+
+	if (size == 0) {
+		g_mapped_file_unref(record->mapped);
+		record->mapped = NULL;
+		if (writable && !write_all(fd, (const guint8 *) GEMINI_RECORD_MAGIC, GEMINI_RECORD_MAGIC_SIZE)) {
+			gint saved_errno = errno;
+
+			g_set_error(
+				error,
+				G_FILE_ERROR,
+				g_file_error_from_errno(saved_errno),
+				"Cannot write %s: %s",
+				path,
+				g_strerror(saved_errno)
+			);
+			close(fd);
+			gst_gemini_record_close(record);
+			return NULL;
+		}
+	} else {
+		const guint8 *data = (const guint8 *) g_mapped_file_get_contents(record->mapped);
+
+		if (size < GEMINI_RECORD_MAGIC_SIZE || memcmp(data, GEMINI_RECORD_MAGIC, GEMINI_RECORD_MAGIC_SIZE) != 0) {
+			g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a record file", path);
+			close(fd);
+			gst_gemini_record_close(record);
+			return NULL;
+		}
+		gsize end = index_records(record, data, size);
+
+		if (end < size) {
+			// Only the pages before the cut are ever read from the mapping.
+			// A reader may also see a record that is still being written.
+			GST_WARNING(
+				"%s ends with an incomplete record, %" G_GSIZE_FORMAT " bytes %s",
+				path,
+				size - end,
+				writable ? "cut off" : "ignored"
+			);
+			if (writable && ftruncate(fd, end) != 0) {
+				gint saved_errno = errno;
+
+				g_set_error(
+					error,
+					G_FILE_ERROR,
+					g_file_error_from_errno(saved_errno),
+					"Cannot truncate %s: %s",
+					path,
+					g_strerror(saved_errno)
+				);
+				close(fd);
+				gst_gemini_record_close(record);
+				return NULL;
+			}
+		}
+	}
+
+	if (writable) {
+		unlock_file(fd);
+		record->fd = fd;
+	} else {
+		close(fd);
+	}
+	GST_INFO(
+		"Opened %s with %u recorded response(s)",
+		path,
+		g_hash_table_size(record->index)
+	);
+	return record;
+}
+
+void
+gst_gemini_record_close (GstGeminiRecord *record) {
+	if (!record) {
+		return;
+	}
+	// The index points into the mapping
+	g_hash_table_unref(record->index);
+	if (record->mapped) {
+		g_mapped_file_unref(record->mapped);
+	}
+	if (record->fd >= 0) {
+		close(record->fd);
+	}
+	g_mutex_clear(&record->lock);
+	g_free(record->path);
+	g_free(record);
+}
+
+gchar *
+gst_gemini_record_lookup (GstGeminiRecord *record, const guint8 *key) {
+	GBytes *lookup_key = g_bytes_new_static(key, GST_GEMINI_RECORD_KEY_SIZE);
+	gchar *text = NULL;
+	GBytes *value;
+
+	g_mutex_lock(&record->lock);
+	value = g_hash_table_lookup(record->index, lookup_key);
+	if (value) {
+		gsize len;
+		const gchar *data = g_bytes_get_data(value, &len);
+
+		text = g_strndup(data, len);
+	}
+	g_mutex_unlock(&record->lock);
+
+	g_bytes_unref(lookup_key);
+	return text;
+}
+
+gboolean
+gst_gemini_record_append (GstGeminiRecord *record, const guint8 *key, const gchar *text, GError **error) {
+	gsize len = strlen(text);
+	guint32 len_le = GUINT32_TO_LE((guint32) len);
+	gsize size = GEMINI_RECORD_HEADER_SIZE + len;
+	guint8 *data;
+	off_t start;
+	gboolean ok;
+
+	if (record->fd < 0) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_PERM, "%s is open read-only", record->path);
+		return FALSE;
+	}
+	if (len > G_MAXUINT32) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Response too long to record");
+		return FALSE;
+	}
+
+	// One write per record, under the file lock so records appended by
+	// several processes at once neither interleave nor get cut off
+	data = g_malloc(size);
+	memcpy(data, key, GST_GEMINI_RECORD_KEY_SIZE);
+	memcpy(data + GST_GEMINI_RECORD_KEY_SIZE, &len_le, sizeof(len_le));
+	memcpy(data + GEMINI_RECORD_HEADER_SIZE, text, len);
+
+	g_mutex_lock(&record->lock);
+	lock_file(record->fd);
+	start = lseek(record->fd, 0, SEEK_END);
+	ok = start >= 0 && write_all(record->fd, data, size);
+	if (ok) {
+		g_hash_table_replace(
+			record->index,
+			g_bytes_new(key, GST_GEMINI_RECORD_KEY_SIZE),
+			g_bytes_new(text, len)
+		);
+	} else {
+		gint saved_errno = errno;
+
+		g_set_error(
+			error,
+			G_FILE_ERROR,
+			g_file_error_from_errno(saved_errno),
+			"Cannot write %s: %s",
+			record->path,
+			g_strerror(saved_errno)
+		);
+		// A partial record would hide every record appended after it
+		if (start >= 0 && ftruncate(record->fd, start) != 0) {
+			GST_WARNING("Cannot cut the partial record off %s", record->path);
+		}
+	}
+	unlock_file(record->fd);
+	g_mutex_unlock(&record->lock);
+
+	g_free(data);
+	return ok;
+}
@@ -0,0 +1,39 @@
+#ifndef __GST_GEMINI_RECORD_H__
+#define __GST_GEMINI_RECORD_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// Size of a record key, a SHA-256 digest
+#define GST_GEMINI_RECORD_KEY_SIZE 32
+
+typedef struct _GstGeminiRecord GstGeminiRecord;
+
+// An append-only file of responses, each stored under the digest of the
+// request that produced it. The file is memory-mapped when opened and
+// indexed in memory, so a lookup copies one response out of the page cache
+// and opening a large file reads only the record headers. Responses
+// recorded later are appended with one write each and indexed as they
+// come. A record cut short by a crash ends the file, and is cut off when
+// the file is opened for writing. When a key occurs more than once the last
+// record wins. All functions may be called from any thread. Several
+// processes may write to one file: appends and the cut at open hold an
+// exclusive flock(), so no record of another process is cut off. Records
+// appended by other processes after opening are not seen.
+//
+// Returns NULL and sets error if the file cannot be opened or is not a
+// record file. A read-only file that does not exist is opened empty.
+GstGeminiRecord *gst_gemini_record_open (const gchar *path, gboolean writable, GError **error);
+void gst_gemini_record_close (GstGeminiRecord *record);
+
+// Copy of the response recorded under key, NULL if there is none
+gchar *gst_gemini_record_lookup (GstGeminiRecord *record, const guint8 *key);
+
+// Appends text under key. Returns FALSE and sets error if the write failed,
+// or if the record was opened read-only.
+gboolean gst_gemini_record_append (GstGeminiRecord *record, const guint8 *key, const gchar *text, GError **error);
+
+G_END_DECLS
+
+#endif /* __GST_GEMINI_RECORD_H__ */
@@ -0,0 +1,613 @@
+// src/gstgeminiresponse.c
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstgeminiresponse.h"
+#include <string.h>
+
+// Containers deeper than this are skipped as a whole, none of the fields we
+// read is nested that deep
+#define GEMINI_RESPONSE_MAX_DEPTH 16
+
+// Longest member name we compare, longer names are never ones we read
+#define GEMINI_RESPONSE_MAX_KEY 32
+
+// Longest number we read, token counts are far shorter
+#define GEMINI_RESPONSE_MAX_SCALAR 32
+
+// Member names on the paths we read
+typedef enum {
+	FIELD_OTHER,
+	FIELD_CANDIDATES,
+	FIELD_CONTENT,
+	FIELD_PARTS,
+	FIELD_TEXT,
+	FIELD_FINISH_REASON,
+	FIELD_USAGE_METADATA,
+	FIELD_PROMPT_TOKEN_COUNT,
+	FIELD_CANDIDATES_TOKEN_COUNT,
+	FIELD_TOTAL_TOKEN_COUNT,
+	FIELD_CACHED_TOKEN_COUNT,
+	FIELD_ERROR,
+	FIELD_MESSAGE
+} GeminiField;
+
+static const struct {
+	const gchar *name;
+	GeminiField field;
+} gemini_fields[] = {
+	{ "candidates", FIELD_CANDIDATES },
+	{ "content", FIELD_CONTENT },
+	{ "parts", FIELD_PARTS },
+	{ "text", FIELD_TEXT },
+	{ "finishReason", FIELD_FINISH_REASON },
+	{ "usageMetadata", FIELD_USAGE_METADATA },
+	{ "promptTokenCount", FIELD_PROMPT_TOKEN_COUNT },
+	{ "candidatesTokenCount", FIELD_CANDIDATES_TOKEN_COUNT },
+	{ "totalTokenCount", FIELD_TOTAL_TOKEN_COUNT },
+	{ "cachedContentTokenCount", FIELD_CACHED_TOKEN_COUNT },
+	{ "error", FIELD_ERROR },
+	{ "message", FIELD_MESSAGE },
+};
+
+// Where the value being read goes
+typedef enum {
+	TARGET_NONE,
+	TARGET_TEXT,
+	TARGET_FINISH_REASON,
+	TARGET_ERROR_MESSAGE,
+	TARGET_PROMPT_TOKENS,
+	TARGET_CANDIDATES_TOKENS,
+	TARGET_TOTAL_TOKENS,
+	TARGET_CACHED_TOKENS
+} GeminiTarget;
+
+typedef struct {
+	gboolean is_object;
+	gboolean expect_key;        // The next string of the object is a member name
+	GeminiField field;          // Member being read, FIELD_OTHER in arrays
+	guint index;                // Element being read in arrays
+} GeminiLevel;
+
+typedef enum {
+	STATE_VALUE,                // Between tokens
+	STATE_STRING,
+	STATE_ESCAPE,               // After a backslash in a string
+	STATE_UNICODE,              // In the four digits of \uXXXX
+	STATE_SCALAR,               // In a number, true, false or null
+	STATE_FAILED
+} GeminiParseState;
+
+typedef enum {
+	SSE_LINE_START,
+	SSE_FIELD,                  // Reading the field name of a line
+	SSE_DATA_START,             // After "data:", one space may follow
+	SSE_DATA,
+	SSE_IGNORE                  // Rest of a line that is not data
+} GeminiSseState;
+
+struct _GstGeminiResponse {
+	GString *text;
+	gboolean has_text;
+	GString *finish_reason;
+	gboolean has_finish_reason;
+	GString *error;
+	gboolean has_error;
+	gboolean has_usage;
+	gint64 prompt_tokens;
+	gint64 candidates_tokens;
+	gint64 total_tokens;
+	gint64 cached_tokens;
+
+	// JSON scanner
+	GeminiParseState state;
+	GeminiLevel levels[GEMINI_RESPONSE_MAX_DEPTH];
+	guint depth;                // Open containers we track
+	guint skip_depth;           // Open containers beyond those
+	gboolean string_is_key;
+	GeminiTarget target;
+	GString *dest;              // Receives the string being read, or NULL
+	gchar key[GEMINI_RESPONSE_MAX_KEY];
+	guint key_len;
+	gchar scalar[GEMINI_RESPONSE_MAX_SCALAR];
+	guint scalar_len;
+	guint unicode_digits;
+	gunichar unicode;
+	gunichar high_surrogate;    // First half of a surrogate pair
+
+	// Server-sent events
+	GeminiSseState sse_state;
+	gchar sse_field[8];
+	guint sse_field_len;
+	gboolean sse_event_has_data;
+};
+
+GstGeminiResponse *
+gst_gemini_response_new (void) {
+	GstGeminiResponse *response = g_new0(GstGeminiResponse, 1);
+
+	response->text = g_string_new(NULL);
+	response->finish_reason = g_string_new(NULL);
+	response->error = g_string_new(NULL);
+	gst_gemini_response_reset(response);
+	return response;
+}
+
+void
+gst_gemini_response_free (GstGeminiResponse *response) {
+	if (!response) {
+		return;
+	}
+	g_string_free(response->text, TRUE);
+	g_string_free(response->finish_reason, TRUE);
+	g_string_free(response->error, TRUE);
+	g_free(response);
+}
+
+// Starts a new JSON document, the fields read so far are kept
+static void
+begin_document(GstGeminiResponse *response) {
+	response->state = STATE_VALUE;
+	response->depth = 0;
+	response->skip_depth = 0;
+	response->dest = NULL;
+	response->high_surrogate = 0;
+}
+
+void
+gst_gemini_response_reset (GstGeminiResponse *response) {
+	g_string_truncate(response->text, 0);
+	g_string_truncate(response->finish_reason, 0);
+	g_string_truncate(response->error, 0);
+	response->has_text = FALSE;
+	response->has_finish_reason = FALSE;
+	response->has_error = FALSE;
+	response->has_usage = FALSE;
+	response->prompt_tokens = -1;
+	response->candidates_tokens = -1;
+	response->total_tokens = -1;
+	response->cached_tokens = -1;
+	response->sse_state = SSE_LINE_START;
+	response->sse_event_has_data = FALSE;
+	begin_document(response);
+}
+
+static GeminiField
+lookup_field(const gchar *name, guint len) {
+	for (guint i = 0; i < G_N_ELEMENTS(gemini_fields); i++) {
+		if (strlen(gemini_fields[i].name) == len && memcmp(gemini_fields[i].name, name, len) == 0) {
+			return gemini_fields[i].field;
+		}
+	}
+	return FIELD_OTHER;
+}
+
+// Decides from the open containers where a value starting now belongs
+static GeminiTarget
+value_target(const GstGeminiResponse *response) {
+	const GeminiLevel *l = response->levels;
+
+	if (response->skip_depth > 0) {
+		return TARGET_NONE;
+	}
+	switch (response->depth) {
+		case 2:
+			// error.message, usageMetadata.*
+			if (l[0].field == FIELD_ERROR && l[1].field == FIELD_MESSAGE) {
+				return TARGET_ERROR_MESSAGE;
+			}
+			if (l[0].field == FIELD_USAGE_METADATA) {
+				switch (l[1].field) {
+					case FIELD_PROMPT_TOKEN_COUNT: return TARGET_PROMPT_TOKENS;
+					case FIELD_CANDIDATES_TOKEN_COUNT: return TARGET_CANDIDATES_TOKENS;
+					case FIELD_TOTAL_TOKEN_COUNT: return TARGET_TOTAL_TOKENS;
+					case FIELD_CACHED_TOKEN_COUNT: return TARGET_CACHED_TOKENS;
+					default: return TARGET_NONE;
+				}
+			}
+			return TARGET_NONE;
+		case 3:
+			// candidates[0].finishReason
+			if (l[0].field == FIELD_CANDIDATES && !l[1].is_object && l[1].index == 0 &&
+				l[2].field == FIELD_FINISH_REASON) {
+				return TARGET_FINISH_REASON;
+			}
+			return TARGET_NONE;
+		case 6:
+			// candidates[0].content.parts[*].text
+			if (l[0].field == FIELD_CANDIDATES && !l[1].is_object && l[1].index == 0 &&
+				l[2].field == FIELD_CONTENT && l[3].field == FIELD_PARTS && !l[4].is_object &&
+				l[5].field == FIELD_TEXT) {
+				return TARGET_TEXT;
+			}
+			return TARGET_NONE;
+		default:
+			return TARGET_NONE;
+	}
+}
+
+// Called when a string or scalar value starts
+static void
+begin_value(GstGeminiResponse *response, gboolean is_string) {
+	response->target = value_target(response);
+	response->dest = NULL;
+	if (!is_string) {
+		// Only token counts are read from scalars
+		return;
+	}
+
+	switch (response->target) {
+		case TARGET_TEXT:
+			// All text parts of the candidate, and of every event of a
+			// stream, add up to one description
+			response->has_text = TRUE;
+			response->dest = response->text;
+			break;
+		case TARGET_FINISH_REASON:
+			response->has_finish_reason = TRUE;
+			g_string_truncate(response->finish_reason, 0);
+			response->dest = response->finish_reason;
+			break;
+		case TARGET_ERROR_MESSAGE:
+			g_string_truncate(response->error, 0);
+			response->dest = response->error;
+			break;
+		default:
+			break;
+	}
+}
+
+static void
+end_scalar(GstGeminiResponse *response) {
+	gint64 value;
+
+	if (response->target < TARGET_PROMPT_TOKENS) {
+		return;
+	}
+	response->scalar[MIN(response->scalar_len, GEMINI_RESPONSE_MAX_SCALAR - 1)] = '\0';
+	value = g_ascii_strtoll(response->scalar, NULL, 10);
+	response->has_usage = TRUE;
+	switch (response->target) {
+		case TARGET_PROMPT_TOKENS: response->prompt_tokens = value; break;
+		case TARGET_CANDIDATES_TOKENS: response->candidates_tokens = value; break;
+		case TARGET_TOTAL_TOKENS: response->total_tokens = value; break;
+		case TARGET_CACHED_TOKENS: response->cached_tokens = value; break;
+		default: break;
+	}
+}
+
+static void
+end_string(GstGeminiResponse *response) {
+	if (response->string_is_key) {
+		GeminiLevel *top = &response->levels[response->depth - 1];
+
+		top->field = response->key_len < GEMINI_RESPONSE_MAX_KEY ?
+			lookup_field(response->key, response->key_len) : FIELD_OTHER;
+		top->expect_key = FALSE;
+		// An error without a message is still an error
+		if (response->depth == 1 && top->field == FIELD_ERROR) {
+			response->has_error = TRUE;
+			g_string_truncate(response->error, 0);
+		}
+	}
+	response->dest = NULL;
+	response->state = STATE_VALUE;
+}
+
+static void
+append_string(GstGeminiResponse *response, const gchar *data, gsize len) {
+	if (response->string_is_key) {
+		if (response->key_len + len < GEMINI_RESPONSE_MAX_KEY) {
+			memcpy(response->key + response->key_len, data, len);
+		}
+		response->key_len += len;
+	} else if (response->dest) {
+		g_string_append_len(response->dest, data, len);
+	}
+}
+
+static void
+append_unichar(GstGeminiResponse *response, gunichar c) {
+	gchar utf8[6];
+
+	append_string(response, utf8, g_unichar_to_utf8(c, utf8));
+}
+
+// Handles a character between tokens. Returns FALSE if it cannot be JSON.
+static gboolean
+handle_token(GstGeminiResponse *response, gchar c) {
+	GeminiLevel *top = response->depth > 0 ? &response->levels[response->depth - 1] : NULL;
+
+	switch (c) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			return TRUE;
+		case '{':
+		case '[':
+			if (response->skip_depth > 0 || response->depth == GEMINI_RESPONSE_MAX_DEPTH) {
+				response->skip_depth++;
+				return TRUE;
+			}
+			top = &response->levels[response->depth++];
+			top->is_object = c == '{';
+			top->expect_key = top->is_object;
+			top->field = FIELD_OTHER;
+			top->index = 0;
+			return TRUE;
+		case '}':
+		case ']':
+			if (response->skip_depth > 0) {
+				response->skip_depth--;
+				return TRUE;
+			}
+			if (!top || top->is_object != (c == '}')) {
+				return FALSE;
+			}
+			response->depth--;
+			return TRUE;
+		case ',':
+			if (response->skip_depth > 0) {
+				return TRUE;
+			}
+			if (!top) {
+				return FALSE;
+			}
+			if (top->is_object) {
+				top->expect_key = TRUE;
+				top->field = FIELD_OTHER;
+			} else {
+				top->index++;
+			}
+			return TRUE;
+		case ':':
+			return response->skip_depth > 0 || (top && top->is_object);
+		case '"':
+			response->string_is_key = response->skip_depth == 0 && top && top->is_object && top->expect_key;
+			response->dest = NULL;
+			if (response->string_is_key) {
+				response->key_len = 0;
+			} else if (response->skip_depth == 0) {
+				begin_value(response, TRUE);
+			}
+			response->state = STATE_STRING;
+			return TRUE;
+		default:
+			if (!g_ascii_isalnum(c) && c != '-') {
+				return FALSE;
+			}
+			if (response->skip_depth == 0) {
+				begin_value(response, FALSE);
+			} else {
+				response->target = TARGET_NONE;
+			}
+			response->scalar_len = 0;
+			response->scalar[response->scalar_len++] = c;
+			response->state = STATE_SCALAR;
+			return TRUE;
+	}
+}
+
+gboolean
+gst_gemini_response_feed (GstGeminiResponse *response, const gchar *data, gsize len) {
+	gsize i = 0;
+
+	while (i < len) {
+		const gchar c = data[i];
+
+		switch (response->state) {
+			case STATE_STRING: {
+				// Plain characters are copied in runs, most strings have no
+				// escapes at all
+				gsize run = i;
+				while (run < len && data[run] != '"' && data[run] != '\\') {
+					run++;
+				}
+				append_string(response, data + i, run - i);
+				i = run;
+				if (i < len) {
+					if (data[i] == '"') {
+						end_string(response);
+					} else {
+						response->state = STATE_ESCAPE;
+					}
+					i++;
+				}
+				continue;
+			}
+			case STATE_ESCAPE: {
+				static const gchar escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+				const gchar *e;
+
+				response->state = STATE_STRING;
+				if (c == 'u') {
+					response->unicode = 0;
+					response->unicode_digits = 0;
+					response->state = STATE_UNICODE;
+				} else if (c != '\0' && (e = strchr(escapes, c)) && (e - escapes) % 2 == 0) {
+					append_string(response, e + 1, 1);
+				} else {
+					append_unichar(response, 0xFFFD);
+				}
+				break;
+			}
+			case STATE_UNICODE:
+				if (!g_ascii_isxdigit(c)) {
+					response->state = STATE_FAILED;
+					return FALSE;
+				}
+				response->unicode = (response->unicode << 4) | g_ascii_xdigit_value(c);
+				if (++response->unicode_digits < 4) {
+					break;
+				}
+				response->state = STATE_STRING;
+				if (response->unicode >= 0xD800 && response->unicode < 0xDC00) {
+					// Completed by the low surrogate that should follow
+					response->high_surrogate = response->unicode;
+				} else if (response->unicode >= 0xDC00 && response->unicode < 0xE000 && response->high_surrogate) {
+					append_unichar(
+						response,
+						0x10000 + ((response->high_surrogate - 0xD800) << 10) + (response->unicode - 0xDC00)
+					);
+					response->high_surrogate = 0;
+				} else {
+					append_unichar(response, g_unichar_validate(response->unicode) ? response->unicode : 0xFFFD);
+				}
+				break;
+			case STATE_SCALAR:
+				if (g_ascii_isalnum(c) || c == '-' || c == '+' || c == '.') {
+					if (response->scalar_len < GEMINI_RESPONSE_MAX_SCALAR) {
+						response->scalar[response->scalar_len++] = c;
+					}
+					break;
+				}
+				end_scalar(response);
+				response->state = STATE_VALUE;
+				// The character after a scalar is a token of its own
+				/* fall through */
+			case STATE_VALUE:
+				if (!handle_token(response, c)) {
+					response->state = STATE_FAILED;
+					return FALSE;
+				}
+				break;
+			case STATE_FAILED:
+				return FALSE;
+		}
+		i++;
+	}
+	return TRUE;
+}
+
+static void
+end_event(GstGeminiResponse *response) {
+	if (response->state == STATE_SCALAR) {
+		end_scalar(response);
+	}
+	response->sse_event_has_data = FALSE;
+}
+
+gsize
+gst_gemini_response_feed_sse (GstGeminiResponse *response, const gchar *data, gsize len, gboolean *event_end) {
+	gsize i = 0;
+
+	*event_end = FALSE;
+	while (i < len) {
+		const gchar c = data[i];
+
+		switch (response->sse_state) {
+			case SSE_LINE_START:
+				if (c == '\r') {
+					break;
+				}
+				if (c == '\n') {
+					// An empty line dispatches the event
+					if (response->sse_event_has_data) {
+						end_event(response);
+						*event_end = TRUE;
+						return i + 1;
+					}
+					break;
+				}
+				response->sse_field_len = 0;
+				response->sse_state = SSE_FIELD;
+				/* fall through */
+			case SSE_FIELD:
+				if (c == ':' || c == '\n') {
+					gboolean is_data = response->sse_field_len == 4 && memcmp(response->sse_field, "data", 4) == 0;
+
+					if (is_data) {
+						if (!response->sse_event_has_data) {
+							begin_document(response);
+							response->sse_event_has_data = TRUE;
+						} else {
+							// Data lines are joined by a newline, whitespace to JSON
+							gst_gemini_response_feed(response, "\n", 1);
+						}
+					}
+					if (c == '\n') {
+						response->sse_state = SSE_LINE_START;
+					} else {
+						response->sse_state = is_data ? SSE_DATA_START : SSE_IGNORE;
+					}
+				} else if (response->sse_field_len < sizeof(response->sse_field)) {
+					response->sse_field[response->sse_field_len++] = c;
+				}
+				break;
+			case SSE_DATA_START:
+				response->sse_state = SSE_DATA;
+				if (c == ' ') {
+					break;
+				}
+				/* fall through */
+			case SSE_DATA: {
+				const gchar *nl = memchr(data + i, '\n', len - i);
+				gsize n = nl ? (gsize) (nl - (data + i)) : len - i;
+
+				gst_gemini_response_feed(response, data + i, n);
+				i += n;
+				if (nl) {
+					response->sse_state = SSE_LINE_START;
+					i++;
+				}
+				continue;
+			}
+			case SSE_IGNORE:
+				if (c == '\n') {
+					response->sse_state = SSE_LINE_START;
+				}
+				break;
+		}
+		i++;
+	}
+	return i;
+}
+
+void
+gst_gemini_response_finish (GstGeminiResponse *response) {
+	if (response->sse_event_has_data) {
+		end_event(response);
+	} else if (response->state == STATE_SCALAR) {
+		end_scalar(response);
+	}
+}
+
+const gchar *
+gst_gemini_response_get_text (const GstGeminiResponse *response) {
+	return response->has_text ? response->text->str : NULL;
+}
+
+const gchar *
+gst_gemini_response_get_finish_reason (const GstGeminiResponse *response) {
+	return response->has_finish_reason ? response->finish_reason->str : NULL;
+}
+
+const gchar *
+gst_gemini_response_get_error (const GstGeminiResponse *response) {
+	return response->has_error ? response->error->str : NULL;
+}
+
+gboolean
+gst_gemini_response_get_usage (
+	const GstGeminiResponse *response,
+	gint64 *prompt_tokens,
+	gint64 *candidates_tokens,
+	gint64 *total_tokens
+) {
+	*prompt_tokens = response->prompt_tokens;
+	*candidates_tokens = response->candidates_tokens;
+	*total_tokens = response->total_tokens;
+	return response->has_usage;
+}
+
+gint64
+gst_gemini_response_get_cached_tokens (const GstGeminiResponse *response) {
+	return response->cached_tokens;
+}
+
+gboolean
+gst_gemini_response_is_valid (const GstGeminiResponse *response) {
+	return response->state != STATE_FAILED;
+}
@@ -0,0 +1,62 @@
+#ifndef __GST_GEMINI_RESPONSE_H__
+#define __GST_GEMINI_RESPONSE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstGeminiResponse GstGeminiResponse;
+
+// Reads a generateContent response as curl delivers it, without building a
+// DOM. Only the fields the element uses are kept: the text parts of the
+// first candidate, its finishReason, usageMetadata and error.message.
+// Everything else, safety ratings and further candidates included, is
+// skipped while scanning. A response is reset and reused for the next
+// request, so its buffers are only allocated once per transfer.
+GstGeminiResponse *gst_gemini_response_new (void);
+void gst_gemini_response_free (GstGeminiResponse *response);
+
+// Forgets the previous response, keeping the allocated buffers
+void gst_gemini_response_reset (GstGeminiResponse *response);
+
+// Feeds bytes of a plain JSON response. Returns FALSE once the bytes stop
+// looking like JSON, everything after that is ignored.
+gboolean gst_gemini_response_feed (GstGeminiResponse *response, const gchar *data, gsize len);
+
+// Feeds bytes of a server-sent event stream, each event holding one JSON
+// response whose text is appended to the text so far. Stops after the
+// first event that ends within data and sets event_end. Returns the number
+// of bytes consumed.
+gsize gst_gemini_response_feed_sse (GstGeminiResponse *response, const gchar *data, gsize len, gboolean *event_end);
+
+// Ends the last event of a stream that did not end with an empty line
+void gst_gemini_response_finish (GstGeminiResponse *response);
+
+// Text of the first candidate, NULL if the response had none
+const gchar *gst_gemini_response_get_text (const GstGeminiResponse *response);
+
+// finishReason of the first candidate, NULL if not given
+const gchar *gst_gemini_response_get_finish_reason (const GstGeminiResponse *response);
+
+// error.message of an error response, empty if the error had no message
+// and NULL if the response was not an error
+const gchar *gst_gemini_response_get_error (const GstGeminiResponse *response);
+
+// Token counts of usageMetadata, -1 where not given. Returns FALSE if the
+// response had no usageMetadata.
+gboolean gst_gemini_response_get_usage (
+	const GstGeminiResponse *response,
+	gint64 *prompt_tokens,
+	gint64 *candidates_tokens,
+	gint64 *total_tokens
+);
+
+// Prompt tokens served from cached content, -1 if not given
+gint64 gst_gemini_response_get_cached_tokens (const GstGeminiResponse *response);
+
+// FALSE if the bytes fed were not JSON
+gboolean gst_gemini_response_is_valid (const GstGeminiResponse *response);
+
+G_END_DECLS
+
+#endif /* __GST_GEMINI_RESPONSE_H__ */
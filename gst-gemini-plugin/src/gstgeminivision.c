@@ -9,8 +9,8 @@
 #include <json-c/json.h>
 
 
-#include <glib/gbase64.h> // For Base64
 #include <jpeglib.h>  // For JPEG encoding
+#include <math.h>
 
 GST_DEBUG_CATEGORY (gst_gemini_vision_debug_category);
 #define GST_CAT_DEFAULT gst_gemini_vision_debug_category
@@ -31,6 +31,40 @@ enum {
 	PROP_MAX_OUTPUT_TOKENS,
 	PROP_TOP_P,
 	PROP_TOP_K,
+	PROP_MAX_WIDTH,
+	PROP_MAX_HEIGHT,
+	PROP_MATCH_MODEL_TILE,
+	PROP_ENCODER_THREADS,
+	PROP_JPEG_QUALITY,
+	PROP_TARGET_BYTES,
+	PROP_ENCODER_PROFILE,
+	PROP_GRAYSCALE,
+	PROP_ROI_ANALYSIS,
+	PROP_ROI_PADDING,
+	PROP_MAX_INFLIGHT,
+	PROP_ORDERED_RESULTS,
+	PROP_STREAM_RESPONSES,
+	PROP_MAX_RETRIES,
+	PROP_MAX_RESULT_AGE,
+	PROP_SHARED_DISPATCHER,
+	PROP_PRIORITY,
+	PROP_MAX_RPM,
+	PROP_SHARED_MAX_TRANSFERS,
+	PROP_BATCH_FRAMES,
+	PROP_API_ENDPOINT,
+	PROP_CACHE_PROMPT,
+	PROP_CACHE_TTL,
+	PROP_PREWARM,
+	PROP_SCENE_THRESHOLD,
+	PROP_MAX_ANALYSIS_INTERVAL,
+	PROP_DESCRIPTION_CACHE_SIZE,
+	PROP_DESCRIPTION_CACHE_DISTANCE,
+	PROP_DESCRIPTION_CACHE_HITS,
+	PROP_DESCRIPTION_CACHE_MISSES,
+	PROP_RECORD_FILE,
+	PROP_RECORD_MODE,
+	PROP_HTTP_VERSION,
+	PROP_MAX_STREAMS_IN_FLIGHT,
 	PROP_LAST
 };
 
@@ -121,496 +155,2733 @@ gst_buffer_add_gemini_description_meta(GstBuffer *buffer, const gchar *descripti
     return meta;
 }
 
+GType
+gst_gemini_encoder_profile_get_type (void) {
+	static GType type = 0;
+	static const GEnumValue values[] = {
+		{ GST_GEMINI_ENCODER_PROFILE_FAST, "Fast integer DCT, 4:2:0 chroma", "fast" },
+		{ GST_GEMINI_ENCODER_PROFILE_BALANCED, "Accurate DCT, input chroma subsampling", "balanced" },
+		{ GST_GEMINI_ENCODER_PROFILE_SMALL, "Accurate DCT, 4:2:0 chroma, optimized Huffman tables", "small" },
+		{ 0, NULL, NULL }
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstGeminiEncoderProfile", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+GType
+gst_gemini_record_mode_get_type (void) {
+	static GType type = 0;
+	static const GEnumValue values[] = {
+		{ GST_GEMINI_RECORD_MODE_READ_WRITE, "Replay recorded responses, send and record the rest", "read-write" },
+		{ GST_GEMINI_RECORD_MODE_REPLAY, "Replay recorded responses, never send a request", "replay" },
+		{ GST_GEMINI_RECORD_MODE_RECORD, "Send every request and record the responses", "record" },
+		{ 0, NULL, NULL }
+	};
+
+	if (g_once_init_enter (&type)) {
+		GType _type = g_enum_register_static ("GstGeminiRecordMode", values);
+		g_once_init_leave (&type, _type);
+	}
+	return type;
+}
+
+
+// Number of scanlines handed to libjpeg per jpeg_write_scanlines() call,
+// matches the tallest MCU (2x2 chroma subsampling)
+#define GEMINI_JPEG_ROWS_PER_WRITE 16
+
+// Gemini tiles large images into 768x768 crops, anything bigger than one
+// tile costs more tokens and upload time without adding detail per tile
+#define GEMINI_MODEL_TILE_SIZE 768
+
+// Stripes encoded in parallel hold a multiple of 8 MCU rows. Restart markers
+// are numbered modulo 8, so each stripe then numbers its markers exactly as
+// the joined image needs them.
+#define GEMINI_JPEG_STRIPE_MCU_ROWS 8
+#define GEMINI_MAX_ENCODER_THREADS 64
+
+// Lowest quality target-bytes may drive the encoder down to
+#define GEMINI_JPEG_MIN_QUALITY 10
+
+// Upper bound of max-inflight
+#define GEMINI_MAX_INFLIGHT 64
+
+// Backoff between attempts of a request, in microseconds. The delay doubles
+// with every attempt up to the cap, a random part of it spreads the retries
+// of many requests that failed together.
+#define GEMINI_RETRY_BASE_DELAY (500 * G_TIME_SPAN_MILLISECOND)
+#define GEMINI_RETRY_MAX_DELAY (30 * G_TIME_SPAN_SECOND)
+#define GEMINI_MAX_RETRIES 10
+
+// Upper bound of batch-frames
+#define GEMINI_MAX_BATCH_FRAMES 16
+
+#define GEMINI_DEFAULT_API_ENDPOINT "https://generativelanguage.googleapis.com/v1beta"
+
+// Cached content is kept alive by extending its TTL once less than a
+// quarter of it is left. The dispatcher sends these requests like any
+// other, bounded by their own timeout, and after a failure the prompt is
+// sent inline for a while before trying again.
+#define GEMINI_MIN_CACHE_TTL 60
+#define GEMINI_MAX_CACHE_TTL (7 * 24 * 60 * 60)
+#define GEMINI_CACHE_TIMEOUT (10 * G_TIME_SPAN_SECOND)
+#define GEMINI_CACHE_DELETE_TIMEOUT (2 * G_TIME_SPAN_SECOND)
+#define GEMINI_CACHE_RETRY_DELAY G_TIME_SPAN_MINUTE
+
+// Upper bounds of description-cache-size and description-cache-distance
+#define GEMINI_MAX_DESCRIPTION_CACHE_SIZE 65536
+#define GEMINI_MAX_DESCRIPTION_CACHE_DISTANCE 32
+
+// Stands in for the image data when the request JSON is serialized, plain
+// ASCII so json-c writes it unescaped
+#define GEMINI_IMAGE_PLACEHOLDER "@GEMINI_IMAGE_DATA@"
+
+// Converts RGB-family rows and hands them to libjpeg a batch at a time.
+// The image being compressed starts at first_line of the frame.
+static gboolean
+write_rgb_scanlines(
+	GstGeminiVision *self, 
+	GstGeminiJpegEncoder *enc, 
+	j_compress_ptr cinfo, 
+	const GstVideoFrame *frame, 
+	const GstGeminiRowConverter *conv, 
+	gint first_line
+) {
+	const gint width = GST_VIDEO_FRAME_WIDTH(frame);
+	const gint row_stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+	const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+	JSAMPROW row_pointer[GEMINI_JPEG_ROWS_PER_WRITE];
+	gboolean ok = TRUE;
+
+	GST_DEBUG_OBJECT(
+		self, 
+		"Video stride: %d, row converter: %s", 
+		row_stride, conv->passthrough ? "none" : conv->impl
+	);
+	
+	// Scratch rows for format conversion, a whole batch is handed to libjpeg at once
+	guchar *rgb_rows = NULL;
+	gsize rgb_row_size = (gsize) width * 3;
+	if (!conv->passthrough) {
+		rgb_rows = gst_gemini_jpeg_encoder_get_scratch(enc, rgb_row_size * GEMINI_JPEG_ROWS_PER_WRITE);
+	}
+  
+	// Process image data in batches of rows
+	while (cinfo->next_scanline < cinfo->image_height) {
+		JDIMENSION n_rows = MIN(cinfo->image_height - cinfo->next_scanline, GEMINI_JPEG_ROWS_PER_WRITE);
+		const guchar *src_row = data + ((gsize) (first_line + cinfo->next_scanline) * row_stride);
+
+		if (conv->passthrough) {
+			for (JDIMENSION i = 0; i < n_rows; i++, src_row += row_stride) {
+				row_pointer[i] = (JSAMPROW) src_row;
+			}
+		} else {
+			for (JDIMENSION i = 0; i < n_rows; i++, src_row += row_stride) {
+				row_pointer[i] = rgb_rows + i * rgb_row_size;
+				gst_gemini_row_converter_convert(conv, src_row, row_pointer[i], width);
+			}
+		}
+		
+		if (jpeg_write_scanlines(cinfo, row_pointer, n_rows) != n_rows) {
+			GST_ERROR_OBJECT(self, "Error writing JPEG scanlines");
+			ok = FALSE;
+			break;
+		}
+	}
+
+	return ok;
+}
+
+// Replicates the last sample so partial 8x8 blocks at the right edge do not
+// pull in whatever follows the row in memory
+static inline void
+pad_row_right(guint8 *row, gint width, gint padded_width) {
+	if (padded_width > width) {
+		memset(row + width, row[width - 1], padded_width - width);
+	}
+}
+
+// Feeds YUV input to libjpeg as raw, already downsampled data, so there is no
+// colour conversion and no chroma resampling at all. libjpeg consumes one iMCU
+// row per call (16 luma lines for 4:2:0, 8 for 4:2:2 or grayscale). Lines past
+// the bottom edge repeat the last line. Planes whose width is a multiple of 8
+// are read in place, everything else goes through a padded scratch line.
+// Samples are used as-is, so limited-range video ends up with slightly less
+// contrast than a full-range JFIF would have, which is irrelevant for scene
+// description. When the JPEG has less vertical chroma resolution than the
+// input (4:2:2 encoded as 4:2:0), every other chroma line is skipped, and a
+// grayscale JPEG takes the luma plane only. When only a stripe is compressed,
+// first_line is a multiple of the iMCU height.
+static gboolean
+write_yuv_raw_data(
+	GstGeminiVision *self, 
+	GstGeminiJpegEncoder *enc, 
+	j_compress_ptr cinfo, 
+	const GstVideoFrame *frame, 
+	const GstGeminiRowConverter *conv, 
+	gint first_line
+) {
+	const gint width = GST_VIDEO_FRAME_WIDTH(frame);
+	const gint height = GST_VIDEO_FRAME_HEIGHT(frame);
+	const gint c_width = (width + 1) / 2;
+	const gint c_height = (height + conv->v_sub - 1) / conv->v_sub;
+	const gboolean gray = cinfo->num_components == 1;
+	const gint jpeg_v_sub = cinfo->max_v_samp_factor;   // Luma lines per JPEG chroma line
+	const gint y_lines = DCTSIZE * jpeg_v_sub;
+	const gint y_pad = GST_ROUND_UP_8(width);
+	const gint c_pad = GST_ROUND_UP_8(c_width);
+	const gboolean copy_y = conv->layout == GST_GEMINI_LAYOUT_PACKED_422 || y_pad != width;
+	const gboolean copy_c = conv->layout != GST_GEMINI_LAYOUT_PLANAR || c_pad != c_width;
+	const gboolean luma_odd = GST_VIDEO_FRAME_COMP_POFFSET(frame, 0) != 0;
+	const gboolean u_first = GST_VIDEO_FRAME_COMP_POFFSET(frame, 1) < GST_VIDEO_FRAME_COMP_POFFSET(frame, 2);
+	JSAMPROW y_rows[2 * DCTSIZE], u_rows[DCTSIZE], v_rows[DCTSIZE];
+	JSAMPARRAY planes[3] = { y_rows, u_rows, v_rows };
+	gboolean ok = TRUE;
+
+	// Luma lines, Cb and Cr lines, and one line of still interleaved chroma
+	guint8 *scratch = gst_gemini_jpeg_encoder_get_scratch(
+		enc, 
+		(gsize) y_lines * y_pad + (gsize) 2 * DCTSIZE * c_pad + (gsize) 2 * c_pad
+	);
+	guint8 *y_scratch = scratch;
+	guint8 *u_scratch = y_scratch + (gsize) y_lines * y_pad;
+	guint8 *v_scratch = u_scratch + (gsize) DCTSIZE * c_pad;
+	guint8 *uv_line = v_scratch + (gsize) DCTSIZE * c_pad;
+
+	for (gint i = 0; i < y_lines; i++) {
+		y_rows[i] = copy_y ? y_scratch + (gsize) i * y_pad : NULL;
+	}
+	for (gint i = 0; i < DCTSIZE; i++) {
+		u_rows[i] = copy_c ? u_scratch + (gsize) i * c_pad : NULL;
+		v_rows[i] = copy_c ? v_scratch + (gsize) i * c_pad : NULL;
+	}
+
+	while (cinfo->next_scanline < cinfo->image_height) {
+		const gint y0 = first_line + cinfo->next_scanline;
+
+		for (gint i = 0; i < y_lines; i++) {
+			const gint line = MIN(y0 + i, height - 1);
+			const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 0)
+				+ (gsize) line * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+
+			if (conv->layout == GST_GEMINI_LAYOUT_PACKED_422) {
+				// Y and chroma alternate, then Cb and Cr alternate in the chroma bytes.
+				// 4:2:2 has one chroma line per luma line.
+				guint8 *y_row = y_scratch + (gsize) i * y_pad;
+				conv->deinterleave(src, luma_odd ? uv_line : y_row, luma_odd ? y_row : uv_line, 2 * c_width);
+				pad_row_right(y_row, width, y_pad);
+				if (!gray && i % jpeg_v_sub == 0) {
+					const gint j = i / jpeg_v_sub;
+					conv->deinterleave(uv_line, u_first ? u_rows[j] : v_rows[j], u_first ? v_rows[j] : u_rows[j], c_width);
+					pad_row_right(u_rows[j], c_width, c_pad);
+					pad_row_right(v_rows[j], c_width, c_pad);
+				}
+			} else if (copy_y) {
+				memcpy(y_rows[i], src, width);
+				pad_row_right(y_rows[i], width, y_pad);
+			} else {
+				y_rows[i] = (JSAMPROW) src;
+			}
+		}
+
+		for (gint j = 0; !gray && conv->layout != GST_GEMINI_LAYOUT_PACKED_422 && j < DCTSIZE; j++) {
+			const gint line = MIN((y0 / jpeg_v_sub + j) * jpeg_v_sub / (gint) conv->v_sub, c_height - 1);
+
+			if (conv->layout == GST_GEMINI_LAYOUT_SEMI_PLANAR) {
+				const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 1)
+					+ (gsize) line * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 1);
+				conv->deinterleave(src, u_first ? u_rows[j] : v_rows[j], u_first ? v_rows[j] : u_rows[j], c_width);
+				pad_row_right(u_rows[j], c_width, c_pad);
+				pad_row_right(v_rows[j], c_width, c_pad);
+				continue;
+			}
+
+			// Planar, the component offsets already account for I420 vs YV12 plane order
+			const guint8 *u_src = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA(frame, 1)
+				+ (gsize) line * GST_VIDEO_FRAME_COMP_STRIDE(frame, 1);
+			const guint8 *v_src = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA(frame, 2)
+				+ (gsize) line * GST_VIDEO_FRAME_COMP_STRIDE(frame, 2);
+			if (copy_c) {
+				memcpy(u_rows[j], u_src, c_width);
+				memcpy(v_rows[j], v_src, c_width);
+				pad_row_right(u_rows[j], c_width, c_pad);
+				pad_row_right(v_rows[j], c_width, c_pad);
+			} else {
+				u_rows[j] = (JSAMPROW) u_src;
+				v_rows[j] = (JSAMPROW) v_src;
+			}
+		}
+
+		if (jpeg_write_raw_data(cinfo, planes, y_lines) != (JDIMENSION) y_lines) {
+			GST_ERROR_OBJECT(self, "Error writing JPEG raw data");
+			ok = FALSE;
+			break;
+		}
+	}
+
+	return ok;
+}
+
+// Fits width x height inside max-width/max-height (and the model tile when
+// match-model-tile is set) keeping the aspect ratio. Returns FALSE when the
+// frame already fits and is encoded at its native size.
+static gboolean
+compute_scaled_size(
+	GstGeminiVision *self, 
+	gint width, 
+	gint height, 
+	gint *out_width, 
+	gint *out_height
+) {
+	gint64 max_w = self->max_width > 0 ? self->max_width : G_MAXINT;
+	gint64 max_h = self->max_height > 0 ? self->max_height : G_MAXINT;
+
+	if (self->match_model_tile) {
+		max_w = MIN(max_w, GEMINI_MODEL_TILE_SIZE);
+		max_h = MIN(max_h, GEMINI_MODEL_TILE_SIZE);
+	}
+	if (width <= max_w && height <= max_h) {
+		return FALSE;
+	}
+
+	if ((gint64) width * max_h > (gint64) height * max_w) {
+		// Width is the binding limit
+		*out_width = (gint) max_w;
+		*out_height = (gint) (((gint64) height * max_w + width / 2) / width);
+	} else {
+		*out_height = (gint) max_h;
+		*out_width = (gint) (((gint64) width * max_h + height / 2) / height);
+	}
+	*out_width = CLAMP(*out_width, 1, width);
+	*out_height = CLAMP(*out_height, 1, height);
+	return TRUE;
+}
+
+static void
+clear_scaling(GstGeminiVision *self) {
+	for (guint i = 0; i < G_N_ELEMENTS(self->scalers); i++) {
+		gst_gemini_scaler_clear(&self->scalers[i]);
+	}
+	gst_clear_buffer(&self->scaled_buffer);
+	g_free(self->scale_lines);
+	self->scale_lines = NULL;
+	self->scale_lines_size = 0;
+	self->scale_input = FALSE;
+	self->scale_src_width = 0;
+	self->scale_src_height = 0;
+}
+
+// Prepares the per-plane scalers for frames or regions of the given size.
+// The reduced frame keeps the input's chroma subsampling: RGB input is
+// scaled as RGB, 4:2:0 input becomes I420 and packed 4:2:2 becomes Y42B, so
+// libjpeg still gets raw planes. Regions change size all the time, so the
+// scalers, the reduced frame and the line buffers are only reallocated when
+// they are too small.
+static void
+setup_scaling(GstGeminiVision *self, gint width, gint height) {
+	const GstGeminiRowConverter *conv = &self->row_converter;
+	gint dst_width, dst_height;
+	GstVideoFormat scaled_format;
+	gsize lines_size;
+
+	if (width == self->scale_src_width && height == self->scale_src_height) {
+		return;
+	}
+	self->scale_src_width = width;
+	self->scale_src_height = height;
+	self->scale_input = compute_scaled_size(self, width, height, &dst_width, &dst_height);
+	if (!self->scale_input) {
+		return;
+	}
+
+	switch (conv->layout) {
+		case GST_GEMINI_LAYOUT_RGB:
+			scaled_format = GST_VIDEO_FORMAT_RGB;
+			break;
+		case GST_GEMINI_LAYOUT_PACKED_422:
+			scaled_format = GST_VIDEO_FORMAT_Y42B;
+			break;
+		default:
+			scaled_format = GST_VIDEO_FORMAT_I420;
+			break;
+	}
+	gst_video_info_set_format(&self->scaled_video_info, scaled_format, dst_width, dst_height);
+	gst_gemini_row_converter_init(&self->scaled_converter, scaled_format);
+
+	if (conv->layout == GST_GEMINI_LAYOUT_RGB) {
+		gst_gemini_scaler_init(&self->scalers[0], width, height, dst_width, dst_height, 3);
+	} else {
+		const gint c_width = (width + 1) / 2;
+		const gint c_height = (height + conv->v_sub - 1) / conv->v_sub;
+
+		gst_gemini_scaler_init(&self->scalers[0], width, height, dst_width, dst_height, 1);
+		for (gint p = 1; p < 3; p++) {
+			gst_gemini_scaler_init(
+				&self->scalers[p], 
+				c_width, c_height,
+				GST_VIDEO_INFO_COMP_WIDTH(&self->scaled_video_info, p),
+				GST_VIDEO_INFO_COMP_HEIGHT(&self->scaled_video_info, p),
+				1
+			);
+		}
+	}
+
+	if (!self->scaled_buffer || gst_buffer_get_size(self->scaled_buffer) < GST_VIDEO_INFO_SIZE(&self->scaled_video_info)) {
+		gst_clear_buffer(&self->scaled_buffer);
+		self->scaled_buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(&self->scaled_video_info), NULL);
+	}
+	// Room for one converted RGB line, or luma, interleaved chroma, Cb and Cr lines
+	lines_size = (gsize) GST_ROUND_UP_2(width) * 3 + 4;
+	if (lines_size > self->scale_lines_size) {
+		g_free(self->scale_lines);
+		self->scale_lines = g_malloc(lines_size);
+		self->scale_lines_size = lines_size;
+	}
+
+	GST_DEBUG_OBJECT(
+		self, 
+		"Downscaling %dx%d input to %dx%d %s before encoding", 
+		width, height, dst_width, dst_height, gst_video_format_to_string(scaled_format)
+	);
+}
+
+// Runs every source line of frame through the scalers, writing the mapped
+// self->scaled_buffer. Source lines are converted or deinterleaved one at a
+// time, so the only full-size pass over the frame is the one that reads it.
+static void
+scale_frame(GstGeminiVision *self, const GstVideoFrame *frame, GstVideoFrame *scaled) {
+	const GstGeminiRowConverter *conv = &self->row_converter;
+	const gint width = GST_VIDEO_FRAME_WIDTH(frame);
+	const gint height = GST_VIDEO_FRAME_HEIGHT(frame);
+	const gint c_width = (width + 1) / 2;
+	const gint c_height = (height + conv->v_sub - 1) / conv->v_sub;
+	const gboolean luma_odd = GST_VIDEO_FRAME_COMP_POFFSET(frame, 0) != 0;
+	const gboolean u_first = GST_VIDEO_FRAME_COMP_POFFSET(frame, 1) < GST_VIDEO_FRAME_COMP_POFFSET(frame, 2);
+	guint8 *y_line = self->scale_lines;
+	guint8 *uv_line = y_line + 2 * c_width;
+	guint8 *u_line = uv_line + 2 * c_width;
+	guint8 *v_line = u_line + c_width;
+	const gint n_planes = conv->layout == GST_GEMINI_LAYOUT_RGB ? 1 : 3;
+
+	for (gint p = 0; p < n_planes; p++) {
+		gst_gemini_scaler_reset(
+			&self->scalers[p], 
+			GST_VIDEO_FRAME_PLANE_DATA(scaled, p),
+			GST_VIDEO_FRAME_PLANE_STRIDE(scaled, p)
+		);
+	}
+
+	switch (conv->layout) {
+		case GST_GEMINI_LAYOUT_RGB:
+			for (gint y = 0; y < height; y++) {
+				const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 0)
+					+ (gsize) y * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+				if (!conv->passthrough) {
+					gst_gemini_row_converter_convert(conv, src, self->scale_lines, width);
+					src = self->scale_lines;
+				}
+				gst_gemini_scaler_push_row(&self->scalers[0], src);
+			}
+			break;
+
+		case GST_GEMINI_LAYOUT_PACKED_422:
+			for (gint y = 0; y < height; y++) {
+				const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 0)
+					+ (gsize) y * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+				conv->deinterleave(src, luma_odd ? uv_line : y_line, luma_odd ? y_line : uv_line, 2 * c_width);
+				conv->deinterleave(uv_line, u_first ? u_line : v_line, u_first ? v_line : u_line, c_width);
+				gst_gemini_scaler_push_row(&self->scalers[0], y_line);
+				gst_gemini_scaler_push_row(&self->scalers[1], u_line);
+				gst_gemini_scaler_push_row(&self->scalers[2], v_line);
+			}
+			break;
+
+		case GST_GEMINI_LAYOUT_PLANAR:
+		case GST_GEMINI_LAYOUT_SEMI_PLANAR:
+			for (gint y = 0; y < height; y++) {
+				gst_gemini_scaler_push_row(
+					&self->scalers[0], 
+					(const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 0) + (gsize) y * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0)
+				);
+			}
+			// A grayscale JPEG never looks at the chroma planes
+			for (gint y = 0; y < c_height && !self->grayscale; y++) {
+				const guint8 *u_src, *v_src;
+				if (conv->layout == GST_GEMINI_LAYOUT_SEMI_PLANAR) {
+					const guint8 *src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA(frame, 1)
+						+ (gsize) y * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 1);
+					conv->deinterleave(src, u_first ? u_line : v_line, u_first ? v_line : u_line, c_width);
+					u_src = u_line;
+					v_src = v_line;
+				} else {
+					u_src = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA(frame, 1) + (gsize) y * GST_VIDEO_FRAME_COMP_STRIDE(frame, 1);
+					v_src = (const guint8 *) GST_VIDEO_FRAME_COMP_DATA(frame, 2) + (gsize) y * GST_VIDEO_FRAME_COMP_STRIDE(frame, 2);
+				}
+				gst_gemini_scaler_push_row(&self->scalers[1], u_src);
+				gst_gemini_scaler_push_row(&self->scalers[2], v_src);
+			}
+			break;
+	}
+}
+
+// Vertical chroma subsampling of the JPEG, 0 for grayscale. RGB input is
+// converted to YCbCr with 2x2 subsampled chroma. YUV input keeps its own
+// subsampling in the balanced profile, the others drop 4:2:2 to 4:2:0.
+static inline gint
+jpeg_chroma_v_sub(GstGeminiVision *self, const GstGeminiRowConverter *conv) {
+	if (self->grayscale) {
+		return 0;
+	}
+	if (conv->layout == GST_GEMINI_LAYOUT_RGB || self->encoder_profile != GST_GEMINI_ENCODER_PROFILE_BALANCED) {
+		return 2;
+	}
+	return conv->v_sub;
+}
+
+// Height of one row of MCUs, the unit libjpeg compresses in
+static inline gint
+jpeg_imcu_height(GstGeminiVision *self, const GstGeminiRowConverter *conv) {
+	return DCTSIZE * MAX(jpeg_chroma_v_sub(self, conv), 1);
+}
+
+// Horizontal band of a frame compressed on its own, see encode_frame_to_jpeg()
+typedef struct {
+	GstGeminiVision *self;
+	GstGeminiJpegEncoder *enc;
+	const GstVideoFrame *frame;
+	const GstGeminiRowConverter *conv;
+	gint first_line;
+	gint n_lines;
+	gint quality;
+	gboolean restart_rows;      // Put a restart marker after every MCU row
+	GstBuffer *jpeg;            // Set on success
+} GeminiStripe;
+
+static gboolean
+encode_stripe(GeminiStripe *stripe) {
+	GstGeminiVision *self = stripe->self;
+	const GstGeminiRowConverter *conv = stripe->conv;
+	const gboolean raw_yuv = conv->layout != GST_GEMINI_LAYOUT_RGB;
+	const gint chroma_v_sub = jpeg_chroma_v_sub(self, conv);
+	j_compress_ptr cinfo;
+	gboolean ok;
+
+	// The compressor and its output buffers persist across frames. The first
+	// output buffer is sized for roughly 1 byte per 3 pixels, which a
+	// quality 85 frame seldom exceeds.
+	cinfo = gst_gemini_jpeg_encoder_begin(
+		stripe->enc, 
+		(gsize) GST_VIDEO_FRAME_WIDTH(stripe->frame) * stripe->n_lines / 3
+	);
+	if (!cinfo) {
+		return FALSE;
+	}
+	// libjpeg errors, such as a frame larger than JPEG allows, end up here
+	if (GST_GEMINI_JPEG_ENCODER_CATCH(stripe->enc)) {
+		gst_gemini_jpeg_encoder_abort(stripe->enc);
+		return FALSE;
+	}
+	
+	// Set JPEG parameters
+	cinfo->image_width = GST_VIDEO_FRAME_WIDTH(stripe->frame);
+	cinfo->image_height = stripe->n_lines;
+	
+	cinfo->input_components = 3;
+	cinfo->in_color_space = raw_yuv ? JCS_YCbCr : JCS_RGB;
+	
+	jpeg_set_defaults(cinfo);
+	if (!chroma_v_sub) {
+		jpeg_set_colorspace(cinfo, JCS_GRAYSCALE);
+	}
+	jpeg_set_quality(cinfo, stripe->quality, TRUE);
+
+	switch (self->encoder_profile) {
+		case GST_GEMINI_ENCODER_PROFILE_FAST:
+			cinfo->dct_method = JDCT_IFAST;
+			break;
+		case GST_GEMINI_ENCODER_PROFILE_SMALL:
+			// Per-image Huffman tables, costs a second pass over the coefficients
+			cinfo->optimize_coding = TRUE;
+			break;
+		default:
+			break;
+	}
+
+	if (raw_yuv) {
+		// Input planes are handed over as they are, only the luma sampling
+		// factor decides how many chroma lines are taken
+		cinfo->raw_data_in = TRUE;
+		if (chroma_v_sub) {
+			cinfo->comp_info[0].h_samp_factor = 2;
+			cinfo->comp_info[0].v_samp_factor = chroma_v_sub;
+			cinfo->comp_info[1].h_samp_factor = cinfo->comp_info[1].v_samp_factor = 1;
+			cinfo->comp_info[2].h_samp_factor = cinfo->comp_info[2].v_samp_factor = 1;
+		}
+	}
+	if (stripe->restart_rows) {
+		cinfo->restart_in_rows = 1;
+	}
+	
+	// Start compression
+	jpeg_start_compress(cinfo, TRUE);
+
+	if (raw_yuv) {
+		ok = write_yuv_raw_data(self, stripe->enc, cinfo, stripe->frame, conv, stripe->first_line);
+	} else {
+		ok = write_rgb_scanlines(self, stripe->enc, cinfo, stripe->frame, conv, stripe->first_line);
+	}
+
+	if (!ok) {
+		gst_gemini_jpeg_encoder_abort(stripe->enc);
+		return FALSE;
+	}
+	
+	// Finish compression, the compressor is kept for the next frame
+	stripe->jpeg = gst_gemini_jpeg_encoder_finish(stripe->enc);
+	return stripe->jpeg != NULL;
+}
+
+// Runs on the stripe pool, the encoder thread waits for stripes_pending to drop to 0
+static void
+gemini_stripe_func(gpointer data, gpointer user_data) {
+	GstGeminiVision *self = GST_GEMINI_VISION(user_data);
+
+	encode_stripe((GeminiStripe *) data);
+
+	g_mutex_lock(&self->stripe_lock);
+	if (--self->stripes_pending == 0) {
+		g_cond_signal(&self->stripe_cond);
+	}
+	g_mutex_unlock(&self->stripe_lock);
+}
+
+static void
+clear_stripe_encoders(GstGeminiVision *self) {
+	for (guint i = 0; i < self->n_stripe_encoders; i++) {
+		gst_gemini_jpeg_encoder_clear(&self->stripe_encoders[i]);
+	}
+	g_free(self->stripe_encoders);
+	self->stripe_encoders = NULL;
+	self->n_stripe_encoders = 0;
+}
+
+// Number of stripes the frame is split into. Every stripe but the last holds
+// a multiple of GEMINI_JPEG_STRIPE_MCU_ROWS MCU rows, and there are never more
+// stripes than encoder threads. Prepares the thread pool and the extra
+// compressors when more than one stripe is used.
+static guint
+count_stripes(GstGeminiVision *self, const GstGeminiRowConverter *conv, gint height) {
+	const gint group_lines = GEMINI_JPEG_STRIPE_MCU_ROWS * jpeg_imcu_height(self, conv);
+	guint n_threads = self->encoder_threads > 0 ? (guint) self->encoder_threads : g_get_num_processors();
+	guint n_stripes = MIN(MIN(n_threads, GEMINI_MAX_ENCODER_THREADS), (guint) ((height + group_lines - 1) / group_lines));
+
+	// Optimized Huffman tables differ per stripe, so the small profile
+	// always compresses the whole frame at once
+	if (n_stripes < 2 || self->encoder_profile == GST_GEMINI_ENCODER_PROFILE_SMALL) {
+		return 1;
+	}
+
+	if (self->n_stripe_encoders < n_stripes - 1) {
+		// Compressors point into themselves, so they are never moved around
+		clear_stripe_encoders(self);
+		self->stripe_encoders = g_new(GstGeminiJpegEncoder, n_stripes - 1);
+		self->n_stripe_encoders = n_stripes - 1;
+		for (guint i = 0; i < self->n_stripe_encoders; i++) {
+			gst_gemini_jpeg_encoder_init(&self->stripe_encoders[i]);
+		}
+	}
+
+	// The encoder thread compresses the first stripe itself
+	if (!self->stripe_pool) {
+		GError *error = NULL;
+		self->stripe_pool = g_thread_pool_new(gemini_stripe_func, self, (gint) n_stripes - 1, FALSE, &error);
+		if (!self->stripe_pool) {
+			GST_WARNING_OBJECT(self, "Failed to create JPEG stripe threads: %s", error->message);
+			g_error_free(error);
+			return 1;
+		}
+	} else if (g_thread_pool_get_max_threads(self->stripe_pool) < (gint) n_stripes - 1) {
+		g_thread_pool_set_max_threads(self->stripe_pool, (gint) n_stripes - 1, NULL);
+	}
+
+	return n_stripes;
+}
+
+// Compresses the stripes concurrently and joins them into one JPEG. Each
+// stripe restarts the entropy coder at every MCU row, so the joined image is
+// the concatenation of the stripes' entropy-coded data with a restart marker
+// in between.
+static gboolean
+encode_stripes_parallel(
+	GstGeminiVision *self, 
+	GeminiStripe *stripes, 
+	guint n_stripes, 
+	GstBuffer **jpeg_buffer
+) {
+	GstBuffer *parts[GEMINI_MAX_ENCODER_THREADS];
+	gboolean ok = TRUE;
+
+	self->stripes_pending = n_stripes - 1;
+	for (guint i = 1; i < n_stripes; i++) {
+		g_thread_pool_push(self->stripe_pool, &stripes[i], NULL);
+	}
+	encode_stripe(&stripes[0]);
+
+	g_mutex_lock(&self->stripe_lock);
+	while (self->stripes_pending > 0) {
+		g_cond_wait(&self->stripe_cond, &self->stripe_lock);
+	}
+	g_mutex_unlock(&self->stripe_lock);
+
+	for (guint i = 0; i < n_stripes; i++) {
+		parts[i] = stripes[i].jpeg;
+		ok = ok && parts[i] != NULL;
+	}
+
+	if (ok) {
+		*jpeg_buffer = gst_gemini_jpeg_join_stripes(parts, n_stripes, GST_VIDEO_FRAME_HEIGHT(stripes[0].frame));
+		ok = *jpeg_buffer != NULL;
+		if (!ok) {
+			GST_ERROR_OBJECT(self, "Failed to join %u JPEG stripes", n_stripes);
+		}
+	}
+
+	for (guint i = 0; i < n_stripes; i++) {
+		if (parts[i]) gst_buffer_unref(parts[i]);
+	}
+	return ok;
+}
+
+// Compresses the (possibly downscaled) frame at the given quality. Large
+// frames are split into stripes compressed on several threads. Stripes cover
+// whole groups of MCU rows, the last one takes the remainder.
+static gboolean
+encode_image(
+	GstGeminiVision *self, 
+	const GstVideoFrame *frame, 
+	const GstGeminiRowConverter *conv, 
+	gint quality, 
+	GstBuffer **jpeg_buffer
+) {
+	const gint height = GST_VIDEO_FRAME_HEIGHT(frame);
+	const gint group_lines = GEMINI_JPEG_STRIPE_MCU_ROWS * jpeg_imcu_height(self, conv);
+	const gint n_groups = (height + group_lines - 1) / group_lines;
+	const guint n_stripes = count_stripes(self, conv, height);
+	GeminiStripe stripes[GEMINI_MAX_ENCODER_THREADS];
+
+	for (guint i = 0; i < n_stripes; i++) {
+		GeminiStripe *stripe = &stripes[i];
+
+		stripe->self = self;
+		stripe->enc = i == 0 ? &self->jpeg_encoder : &self->stripe_encoders[i - 1];
+		stripe->frame = frame;
+		stripe->conv = conv;
+		stripe->first_line = (gint) (n_groups * i / n_stripes) * group_lines;
+		stripe->n_lines = i + 1 == n_stripes ? 
+			height - stripe->first_line : 
+			(gint) (n_groups * (i + 1) / n_stripes) * group_lines - stripe->first_line;
+		stripe->quality = quality;
+		stripe->restart_rows = n_stripes > 1;
+		stripe->jpeg = NULL;
+	}
+
+	if (n_stripes == 1) {
+		*jpeg_buffer = encode_stripe(&stripes[0]) ? stripes[0].jpeg : NULL;
+		return *jpeg_buffer != NULL;
+	}
+	return encode_stripes_parallel(self, stripes, n_stripes, jpeg_buffer);
+}
+
+// libjpeg turns quality into a scale factor for the quantization tables
+static inline gdouble
+quality_to_scale(gdouble quality) {
+	return quality < 50.0 ? 5000.0 / quality : 200.0 - 2.0 * quality;
+}
+
+static inline gdouble
+scale_to_quality(gdouble scale) {
+	return scale > 100.0 ? 5000.0 / scale : (200.0 - scale) / 2.0;
+}
+
+// Steers adaptive_quality towards target-bytes. The JPEG size falls roughly
+// with the table scale to a power between 0.3 and 0.8 depending on content,
+// assuming 0.7 converges within a few frames without oscillating much. The
+// quality stays between GEMINI_JPEG_MIN_QUALITY and jpeg-quality.
+static void
+update_adaptive_quality(GstGeminiVision *self, gsize size) {
+	const gdouble ratio = CLAMP((gdouble) size / self->target_bytes, 0.25, 4.0);
+	const gdouble scale = quality_to_scale(self->adaptive_quality) * pow(ratio, 1.0 / 0.7);
+
+	self->adaptive_quality = CLAMP(scale_to_quality(scale), GEMINI_JPEG_MIN_QUALITY, self->jpeg_quality);
+	GST_LOG_OBJECT(
+		self, 
+		"%" G_GSIZE_FORMAT " bytes for a target of %u, next quality %.1f", 
+		size, self->target_bytes, self->adaptive_quality
+	);
+}
+
+// Compresses the (possibly downscaled) frame. With a payload budget the
+// quality follows the size of earlier frames, and a frame far over budget is
+// compressed once more right away.
+static gboolean
+encode_with_quality_control(
+	GstGeminiVision *self, 
+	const GstVideoFrame *frame, 
+	const GstGeminiRowConverter *conv, 
+	GstBuffer **jpeg_buffer
+) {
+	gint quality = self->target_bytes ? (gint) (self->adaptive_quality + 0.5) : self->jpeg_quality;
+	if (!encode_image(self, frame, conv, quality, jpeg_buffer)) {
+		return FALSE;
+	}
+
+	if (self->target_bytes) {
+		gsize size = gst_buffer_get_size(*jpeg_buffer);
+
+		update_adaptive_quality(self, size);
+		if (size > self->target_bytes + self->target_bytes / 4 && (gint) (self->adaptive_quality + 0.5) < quality) {
+			GST_DEBUG_OBJECT(
+				self, 
+				"Frame of %" G_GSIZE_FORMAT " bytes at quality %d exceeds target of %u bytes, encoding again", 
+				size, quality, self->target_bytes
+			);
+			gst_buffer_unref(*jpeg_buffer);
+			*jpeg_buffer = NULL;
+			quality = (gint) (self->adaptive_quality + 0.5);
+			if (!encode_image(self, frame, conv, quality, jpeg_buffer)) {
+				return FALSE;
+			}
+			update_adaptive_quality(self, gst_buffer_get_size(*jpeg_buffer));
+		}
+	}
+
+	GST_DEBUG_OBJECT(
+		self, 
+		"Successfully encoded JPEG image (%" G_GSIZE_FORMAT " bytes, quality %d)", 
+		gst_buffer_get_size(*jpeg_buffer), quality
+	);
+	return TRUE;
+}
+
+// Function to encode raw video frame to JPEG. The frame is mapped with its
+// own plane offsets and strides, which may differ from the caps when the
+// buffer carries a GstVideoMeta.
+static gboolean
+encode_frame_to_jpeg(
+	GstGeminiVision *self, 
+	const GstVideoFrame *frame, 
+	GstBuffer **jpeg_buffer
+) {
+	if (self->encode_video_info.width <= 0 || self->encode_video_info.height <= 0) {
+		GST_ERROR_OBJECT(
+			self, 
+			"Invalid video dimensions: %dx%d", 
+			self->encode_video_info.width, self->encode_video_info.height
+		);
+		return FALSE;
+	}
+  
+	GstVideoFormat format = GST_VIDEO_FRAME_FORMAT(frame);
+	const char *format_name = gst_video_format_to_string(format);
+	GST_DEBUG_OBJECT(
+		self, 
+		"Encoding video format %s to JPEG, dimensions: %dx%d", 
+		format_name, GST_VIDEO_FRAME_WIDTH(frame), GST_VIDEO_FRAME_HEIGHT(frame)
+	);
+  
+	// The row converter was selected in configure_encoder: RGB-family input becomes
+	// 3-component RGB rows, YUV input is passed through as raw YCbCr.
+	const GstGeminiRowConverter *conv = &self->row_converter;
+	if (conv->format != format) {
+		GST_ERROR_OBJECT(self, "Unsupported video format for JPEG encoding: %s", format_name);
+		return FALSE;
+	}
+
+	setup_scaling(self, GST_VIDEO_FRAME_WIDTH(frame), GST_VIDEO_FRAME_HEIGHT(frame));
+	if (!self->scale_input) {
+		return encode_with_quality_control(self, frame, conv, jpeg_buffer);
+	}
+  
+	// Reduce the frame first, the encoder then only sees the small image
+	GstVideoFrame scaled;
+	gboolean ok;
+
+	if (!gst_video_frame_map(&scaled, &self->scaled_video_info, self->scaled_buffer, GST_MAP_READWRITE)) {
+		GST_ERROR_OBJECT(self, "Failed to map the downscaled frame");
+		return FALSE;
+	}
+	scale_frame(self, frame, &scaled);
+	ok = encode_with_quality_control(self, &scaled, &self->scaled_converter, jpeg_buffer);
+	gst_video_frame_unmap(&scaled);
+	return ok;
+}
+
+// Picks the row converter for the frames of a new stream, given the video
+// info of whole frames. Regions of them are encoded with the same converter,
+// only their scaling is set up per size. Called from the encoder thread, so
+// caps can change on the streaming thread while a previous frame is still
+// being encoded.
+static gboolean
+configure_encoder(GstGeminiVision *self, const GstVideoInfo *info) {
+	if (gst_video_info_is_equal(info, &self->encode_video_info)) {
+		return TRUE;
+	}
+
+	GstVideoFormat format = GST_VIDEO_INFO_FORMAT(info);
+	if (format != self->row_converter.format || !self->row_converter.func) {
+		if (!gst_gemini_row_converter_init(&self->row_converter, format)) {
+			GST_ERROR_OBJECT(
+				self, 
+				"Unsupported video format for JPEG encoding: %s", 
+				gst_video_format_to_string(format)
+			);
+			gst_video_info_init(&self->encode_video_info);
+			return FALSE;
+		}
+		GST_INFO_OBJECT(
+			self, 
+			"Using %s row converter for %s (cpu: %s)", 
+			self->row_converter.impl, 
+			gst_video_format_to_string(format), 
+			gst_gemini_convert_get_cpu_impl()
+		);
+	}
+	self->encode_video_info = *info;
+
+	// The scalers depend on the layout and the limits, not only on the size
+	self->scale_src_width = 0;
+	self->scale_src_height = 0;
+
+	// A new stream starts from the configured quality again
+	self->adaptive_quality = self->jpeg_quality;
+	return TRUE;
+}
+
+static void
+gemini_request_data_free(GeminiRequestData *req) {
+	if (req->image) gst_buffer_unref(req->image);
+	g_free(req->api_endpoint);
+	g_free(req->api_key);
+	g_free(req->prompt);
+	g_free(req->model_name);
+	g_free(req->cached_content);
+	if (req->stop_sequences) g_strfreev(req->stop_sequences);
+	if (req->original_buffer) gst_buffer_unref(req->original_buffer);
+	if (req->batch) g_ptr_array_free(req->batch, TRUE);
+	g_free(req);
+}
+
+static void
+gemini_result_data_free(GeminiResultData *res) {
+	g_free(res->description);
+	if (res->original_buffer) gst_buffer_unref(res->original_buffer);
+	if (res->batch) g_ptr_array_free(res->batch, TRUE);
+	g_free(res);
+}
+
+// TRUE once an answer due by deadline would come too late for max-result-age
+static gboolean
+deadline_passed(gint64 deadline) {
+	return deadline != 0 && g_get_monotonic_time() >= deadline;
+}
+
+static GeminiResultData *
+gemini_result_data_new(GeminiRequestData *req, gchar *description, gboolean partial) {
+	GeminiResultData *result_data = g_new0(GeminiResultData, 1);
+
+	result_data->description = description;
+	result_data->partial = partial;
+	result_data->original_buffer = gst_buffer_ref(req->original_buffer);
+	result_data->processor_element = req->self;
+	result_data->analysis_id = req->analysis_id;
+	result_data->seq = req->seq;
+	result_data->deadline = req->batch ? req->frame_deadline : req->deadline;
+	result_data->has_roi = req->has_roi;
+	result_data->roi_id = req->roi_id;
+	result_data->roi_type = req->roi_type;
+	return result_data;
+}
+
+// Splits the answer to a batch, a JSON array with one description per frame
+// in frame order, into n_frames descriptions. Frames the model left out get
+// NULL. An answer that is not such an array is kept whole for the newest
+// frame.
+static gchar **
+split_batch_description(GstGeminiVision *self, const gchar *description, guint n_frames) {
+	gchar **descriptions = g_new0(gchar *, n_frames);
+	json_object *jarray;
+
+	if (!description) {
+		return descriptions;
+	}
+	jarray = json_tokener_parse(description);
+	if (!jarray || !json_object_is_type(jarray, json_type_array)) {
+		GST_WARNING_OBJECT(self, "Batch answer is not a JSON array, keeping it for the newest frame");
+		descriptions[n_frames - 1] = g_strdup(description);
+	} else {
+		if (json_object_array_length(jarray) != n_frames) {
+			GST_WARNING_OBJECT(
+				self, 
+				"Batch of %u frames answered with %u descriptions", 
+				n_frames, 
+				(guint) json_object_array_length(jarray)
+			);
+		}
+		for (guint i = 0; i < n_frames && i < json_object_array_length(jarray); i++) {
+			json_object *jitem = json_object_array_get_idx(jarray, i);
+			if (json_object_is_type(jitem, json_type_string)) {
+				descriptions[i] = g_strdup(json_object_get_string(jitem));
+			}
+		}
+	}
+	if (jarray) json_object_put(jarray);
+	return descriptions;
+}
+
+// Hands the outcome of a request to the streaming side and frees the
+// request. Every request ends up here exactly once, a NULL description
+// marks a request that failed, so results can be put back in order and the
+// in-flight count stays right. The answer to a batch becomes one result per
+// frame, carried by the result of the oldest.
+static void
+queue_result(GstGeminiVision *self, GeminiRequestData *req, gchar *description, gboolean partial) {
+	GeminiResultData *result_data = gemini_result_data_new(req, description, partial);
+
+	if (req->batch && !partial) {
+		gchar **descriptions = split_batch_description(self, description, req->batch->len + 1);
+
+		g_free(result_data->description);
+		result_data->description = descriptions[0];
+		result_data->batch = g_ptr_array_new_with_free_func((GDestroyNotify) gemini_result_data_free);
+		for (guint i = 0; i < req->batch->len; i++) {
+			g_ptr_array_add(
+				result_data->batch, 
+				gemini_result_data_new(g_ptr_array_index(req->batch, i), descriptions[i + 1], FALSE)
+			);
+		}
+		g_free(descriptions);
+	}
+
+	g_async_queue_push(self->result_queue, result_data);
+	// Trigger the GSource in the main GStreamer context to process results
+	if(self->result_source) {
+		g_source_set_ready_time(self->result_source, 0); // Wake it up if it's an idle source
+	}
+}
+
+static void
+push_result(GstGeminiVision *self, GeminiRequestData *req, gchar *description) {
+	// Nothing waits for the end of a prewarm or cached prompt request, the
+	// next one of the latter may be sent now
+	if (req->cache_op != GEMINI_CACHE_OP_NONE) {
+		GST_OBJECT_LOCK(self);
+		self->cache_pending = FALSE;
+		GST_OBJECT_UNLOCK(self);
+	} else if (!req->prewarm) {
+		queue_result(self, req, description, FALSE);
+	}
+	gemini_request_data_free(req);
+}
+
+// Passes the text streamed so far for req, the request stays in flight
+static void
+push_partial(GstGeminiVision *self, GeminiRequestData *req, const gchar *text) {
+	queue_result(self, req, g_strdup(text), TRUE);
+}
+
+// An element started on a dispatcher
+typedef struct {
+	GstGeminiVision *self;
+	GQueue pending;             // Encoded requests waiting for a transfer
+	gint priority;
+	gint max_rpm;               // 0 means no limit
+	gint max_transfers;         // 0 means no limit
+} GeminiClient;
+
+// Every element has a dispatcher of its own unless shared-dispatcher is set,
+// then the elements of the process send through one and share its thread,
+// connections and limits. Requests are picked by priority and round robin
+// among the elements of equal priority.
+struct _GeminiDispatcher {
+	GThread *thread;
+	CURLM *multi;               // Woken by curl_multi_wakeup() for any change below
+	gint users;                 // Elements started on the shared dispatcher
+
+	GMutex lock;                // Protects the fields up to cond
+	gboolean running;
+	GPtrArray *clients;         // GeminiClient
+	guint next_client;          // Where the round robin continues
+	GPtrArray *removed;         // Elements whose transfers are to be dropped
+	gint max_rpm;               // Lowest limit of the clients
+	gint max_transfers;         // Lowest limit of the clients
+	GCond cond;                 // Signalled once the removed elements are gone
+
+	// Dispatcher thread only
+	GPtrArray *transfers;       // GeminiTransfer running on the multi handle
+	GQueue idle_transfers;      // Parked transfers kept for their easy handles
+	GQueue retries;             // Transfers waiting for their next attempt, by due time
+	GArray *request_times;      // Start times within the last minute, for max_rpm
+	gint64 backoff_until;       // No new request starts before, after a 429
+};
+
+static GMutex shared_dispatcher_lock;
+static GeminiDispatcher *shared_dispatcher;
+
+static GeminiClient *
+find_client(GeminiDispatcher *dispatcher, GstGeminiVision *self) {
+	for (guint i = 0; i < dispatcher->clients->len; i++) {
+		GeminiClient *client = g_ptr_array_index(dispatcher->clients, i);
+		if (client->self == self) {
+			return client;
+		}
+	}
+	return NULL;
+}
+
+// Queues a request with the element's dispatcher and wakes it if it is
+// waiting on sockets
+static void
+push_request(GstGeminiVision *self, GeminiRequestData *req) {
+	GeminiDispatcher *dispatcher = self->dispatcher;
+
+	g_mutex_lock(&dispatcher->lock);
+	g_queue_push_tail(&find_client(dispatcher, self)->pending, req);
+	g_mutex_unlock(&dispatcher->lock);
+	curl_multi_wakeup(dispatcher->multi);
+}
+
+
+// Narrows a mapped frame to the region of the request. The region starts on
+// a chroma sample, so every plane moves by whole samples and the crop is
+// encoded like any other frame.
+static void
+crop_frame(GstVideoFrame *frame, const GeminiRequestData *req) {
+	const GstVideoFormatInfo *finfo = frame->info.finfo;
+
+	for (guint p = 0; p < GST_VIDEO_FRAME_N_PLANES(frame); p++) {
+		// The first component stored in the plane gives its subsampling
+		guint c = 0;
+		while (GST_VIDEO_FORMAT_INFO_PLANE(finfo, c) != p) {
+			c++;
+		}
+		frame->data[p] = (guint8 *) frame->data[p]
+			+ (gsize) GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(finfo, c, req->roi_y) * GST_VIDEO_FRAME_PLANE_STRIDE(frame, p)
+			+ (gsize) GST_VIDEO_FORMAT_INFO_SCALE_WIDTH(finfo, c, req->roi_x) * GST_VIDEO_FORMAT_INFO_PSTRIDE(finfo, c);
+	}
+	frame->info.width = req->roi_width;
+	frame->info.height = req->roi_height;
+}
+
+// Fills in the JPEG of one frame. Returns FALSE if it could not be encoded.
+static gboolean
+encode_request(GstGeminiVision *self, GeminiRequestData *req) {
+	GstVideoFrame frame;
+	gboolean ok = FALSE;
+	gint64 start_time = g_get_monotonic_time();
+
+	if (req->is_jpeg) {
+		// The upload reads the camera's JPEG in place: the new buffer only
+		// holds references to the input memory, nothing is copied
+		req->image = gst_buffer_copy_region(
+			req->original_buffer, GST_BUFFER_COPY_MEMORY, 0, -1
+		);
+		if (req->image) {
+			ok = TRUE;
+		} else {
+			GST_ERROR_OBJECT(self, "Failed to reference JPEG data");
+		}
+	} else if (!gst_video_frame_map(&frame, &req->video_info, req->original_buffer, GST_MAP_READ)) {
+		GST_WARNING_OBJECT(self, "Failed to map buffer for analysis.");
+	} else {
+		GstVideoFrame encode_frame = frame;
+
+		// Regions keep the converter and quality state of the stream
+		if (req->has_roi) {
+			crop_frame(&encode_frame, req);
+		}
+		ok = configure_encoder(self, &req->video_info) && 
+			encode_frame_to_jpeg(self, &encode_frame, &req->image);
+		gst_video_frame_unmap(&frame);
+		if (!ok) {
+			GST_ELEMENT_ERROR(self, STREAM, ENCODE, (NULL), ("Failed to encode frame to JPEG"));
+		}
+	}
+
+	if (ok) {
+		GST_DEBUG_OBJECT(
+			self, 
+			"Encoded frame at PTS %" GST_TIME_FORMAT " in %" G_GINT64_FORMAT " us", 
+			GST_TIME_ARGS(GST_BUFFER_PTS(req->original_buffer)), 
+			g_get_monotonic_time() - start_time
+		);
+	}
+	return ok;
+}
+
+// --- Description Cache ---
+typedef struct {
+	guint64 phash;
+	gchar *context;     // settings_digest when it was stored
+	gchar *description;
+} GeminiCacheEntry;
+
+static void
+gemini_cache_entry_free(GeminiCacheEntry *entry) {
+	g_free(entry->context);
+	g_free(entry->description);
+	g_free(entry);
+}
+
+// Digest of the settings besides the images that shape a description, so
+// descriptions obtained under other settings are never served
+static gchar *
+digest_settings(GstGeminiVision *self) {
+	GString *context = g_string_new(NULL);
+	gchar *digest;
+
+	g_string_append_printf(
+		context, 
+		"%s\n%s\n%g\n%d\n%g\n%d\n", 
+		self->model_name ? self->model_name : "", 
+		self->prompt ? self->prompt : "", 
+		self->temperature, 
+		self->max_output_tokens, 
+		self->top_p, 
+		self->top_k
+	);
+	for (gint i = 0; self->stop_sequences && self->stop_sequences[i]; i++) {
+		g_string_append_printf(context, "%s\n", self->stop_sequences[i]);
+	}
+	digest = g_compute_checksum_for_string(G_CHECKSUM_SHA256, context->str, context->len);
+	g_string_free(context, TRUE);
+	return digest;
+}
+
+// Sets the perceptual hash of the frame, or of its region. Returns FALSE
+// if the frame could not be hashed.
+static gboolean
+hash_request_frame(GstGeminiVision *self, GeminiRequestData *req) {
+	guint8 thumbnail[GST_GEMINI_THUMBNAIL_SIZE];
+	GstVideoFrame frame;
+
+	if (!gst_video_frame_map(&frame, &req->video_info, req->original_buffer, GST_MAP_READ)) {
+		GST_WARNING_OBJECT(self, "Failed to map buffer for hashing.");
+		return FALSE;
+	}
+	GstVideoFrame hash_frame = frame;
+
+	if (req->has_roi) {
+		crop_frame(&hash_frame, req);
+	}
+	req->has_phash = gst_gemini_thumbnail(&hash_frame, thumbnail);
+	gst_video_frame_unmap(&frame);
+	if (req->has_phash) {
+		req->phash = gst_gemini_dhash(thumbnail);
+	}
+	return req->has_phash;
+}
+
+// Description of the closest picture within description-cache-distance of
+// req's, NULL on a miss. A hit becomes the most recently used entry.
+static gchar *
+lookup_description(GstGeminiVision *self, const GeminiRequestData *req) {
+	GList *best = NULL;
+	gint best_distance = self->description_cache_distance + 1;
+	gchar *description = NULL;
+
+	g_mutex_lock(&self->description_cache_lock);
+	for (GList *l = self->description_cache.head; l && best_distance > 0; l = l->next) {
+		GeminiCacheEntry *entry = l->data;
+		gint distance = __builtin_popcountll(entry->phash ^ req->phash);
+
+		if (distance < best_distance && g_str_equal(entry->context, self->settings_digest)) {
+			best = l;
+			best_distance = distance;
+		}
+	}
+	if (best) {
+		g_queue_unlink(&self->description_cache, best);
+		g_queue_push_head_link(&self->description_cache, best);
+		description = g_strdup(((GeminiCacheEntry *) best->data)->description);
+		self->description_cache_hits++;
+	} else {
+		self->description_cache_misses++;
+	}
+	g_mutex_unlock(&self->description_cache_lock);
+
+	if (best) {
+		GST_DEBUG_OBJECT(self, "Cached description found %d bit(s) away", best_distance);
+	}
+	return description;
+}
+
+// Keeps the description of req's picture, dropping the least recently used
+// entries beyond description-cache-size
+static void
+store_description(GstGeminiVision *self, const GeminiRequestData *req, const gchar *description) {
+	GeminiCacheEntry *entry = g_new0(GeminiCacheEntry, 1);
+
+	entry->phash = req->phash;
+	entry->context = g_strdup(self->settings_digest);
+	entry->description = g_strdup(description);
+
+	g_mutex_lock(&self->description_cache_lock);
+	g_queue_push_head(&self->description_cache, entry);
+	while (g_queue_get_length(&self->description_cache) > (guint) self->description_cache_size) {
+		gemini_cache_entry_free(g_queue_pop_tail(&self->description_cache));
+	}
+	g_mutex_unlock(&self->description_cache_lock);
+}
+
+// --- Recorded Responses ---
+// Digest of everything a request asks: the settings and the JPEG of each
+// frame. The cached prompt only changes how the prompt is sent, so requests
+// match whether or not cache-prompt is set.
+static gboolean
+compute_record_key(GstGeminiVision *self, GeminiRequestData *req) {
+	GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+	const guint n_images = 1 + (req->batch ? req->batch->len : 0);
+	gsize key_size = GST_GEMINI_RECORD_KEY_SIZE;
+	gboolean ok = TRUE;
+
+	g_checksum_update(checksum, (const guchar *) self->settings_digest, -1);
+	g_checksum_update(checksum, (const guchar *) &n_images, sizeof(n_images));
+	for (guint i = 0; ok && i < n_images; i++) {
+		GeminiRequestData *frame = i == 0 ? req : g_ptr_array_index(req->batch, i - 1);
+		GstMapInfo map;
+		guint64 size;
+
+		ok = gst_buffer_map(frame->image, &map, GST_MAP_READ);
+		if (ok) {
+			size = map.size;
+			g_checksum_update(checksum, (const guchar *) &size, sizeof(size));
+			g_checksum_update(checksum, map.data, map.size);
+			gst_buffer_unmap(frame->image, &map);
+		}
+	}
+	if (ok) {
+		g_checksum_get_digest(checksum, req->record_key, &key_size);
+		req->has_record_key = TRUE;
+	} else {
+		GST_WARNING_OBJECT(self, "Failed to map image data for the record key.");
+	}
+	g_checksum_free(checksum);
+	return ok;
+}
+
+// Recorded response to req, NULL if it has to be sent. The key stays with
+// req, so the response can be recorded once it arrives.
+static gchar *
+replay_response(GstGeminiVision *self, GeminiRequestData *req) {
+	gchar *text;
+
+	if (!compute_record_key(self, req)) {
+		return NULL;
+	}
+	if (self->record_mode == GST_GEMINI_RECORD_MODE_RECORD) {
+		return NULL;
+	}
+	text = gst_gemini_record_lookup(self->record, req->record_key);
+	GST_DEBUG_OBJECT(self, "%s recorded response", text ? "Replaying" : "No");
+	return text;
+}
+
+static void
+record_response(GstGeminiVision *self, const GeminiRequestData *req, const gchar *text) {
+	GError *error = NULL;
+
+	if (!gst_gemini_record_append(self->record, req->record_key, text, &error)) {
+		GST_ELEMENT_WARNING(self, RESOURCE, WRITE, ("Failed to record a response"), ("%s", error->message));
+		g_error_free(error);
+	}
+}
+
+// Whether requests are answered from record-file alone, without an API key
+static gboolean
+replay_only(GstGeminiVision *self) {
+	return self->record && self->record_mode == GST_GEMINI_RECORD_MODE_REPLAY;
+}
+
+// --- Prompt Cache ---
+static size_t
+discard_reply(void *contents, size_t size, size_t nmemb, void *userp) {
+	return size * nmemb;
+}
+
+// Sends the DELETE of the cached prompt of a stopped element. It runs on a
+// thread of its own so that stopping does not wait for the API, and refers
+// to nothing of the element. If it fails the cached content expires anyway.
+static gpointer
+gemini_cache_delete_thread_func(gpointer data) {
+	gchar *url = data;
+	CURL *handle = curl_easy_init();
+	CURLcode res;
+	long status = 0;
+
+	if (!handle) {
+		g_free(url);
+		return NULL;
+	}
+	curl_easy_setopt(handle, CURLOPT_URL, url);
+	curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "DELETE");
+	curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, discard_reply);
+	curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, (long) (GEMINI_CACHE_DELETE_TIMEOUT / G_TIME_SPAN_MILLISECOND));
+	// The timeout must not rely on signals outside the main thread
+	curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+
+	res = curl_easy_perform(handle);
+	if (res == CURLE_OK) {
+		curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+	}
+	if (status >= 200 && status < 300) {
+		GST_DEBUG("Deleted the cached prompt");
+	} else if (res == CURLE_OK) {
+		GST_WARNING("Could not delete the cached prompt, HTTP %ld, it expires on its own", status);
+	} else {
+		GST_WARNING("Could not delete the cached prompt, it expires on its own: %s", curl_easy_strerror(res));
+	}
+	curl_easy_cleanup(handle);
+	g_free(url);
+	return NULL;
+}
+
+// Deletes the cached prompt rather than paying for its storage until it
+// expires, and forgets it. Called once the element no longer sends requests.
+static void
+delete_prompt_cache(GstGeminiVision *self) {
+	gchar *url = NULL;
+
+	GST_OBJECT_LOCK(self);
+	if (self->cache_name && g_get_monotonic_time() < self->cache_expires) {
+		url = g_strdup_printf("%s/%s?key=%s", self->api_endpoint, self->cache_name, self->api_key);
+	}
+	g_clear_pointer(&self->cache_name, g_free);
+	self->cache_retry_at = 0;
+	// A request dropped by stopping never ends
+	self->cache_pending = FALSE;
+	GST_OBJECT_UNLOCK(self);
+
+	if (url) {
+		g_thread_unref(g_thread_new("gemini-cache-delete", gemini_cache_delete_thread_func, url));
+	}
+}
+
+// Logs why the API refused a cachedContents request
+static void
+warn_cache_refused(GstGeminiVision *self, const gchar *action, long status, const GString *reply) {
+	json_object *jroot = json_tokener_parse(reply->str);
+	json_object *jerror, *jmessage;
+	const gchar *message = NULL;
+
+	if (jroot && json_object_object_get_ex(jroot, "error", &jerror) && 
+		json_object_object_get_ex(jerror, "message", &jmessage)) {
+		message = json_object_get_string(jmessage);
+	}
+	GST_WARNING_OBJECT(
+		self, 
+		"Could not %s the cached prompt, HTTP %ld: %s", 
+		action, 
+		status, 
+		message ? message : "no message"
+	);
+	json_object_put(jroot);
+}
+
+// Body of a request creating or extending the cached prompt
+static GstGeminiBody *
+build_cache_body(GstGeminiVision *self, GeminiRequestData *req) {
+	GstGeminiBody *body = gst_gemini_body_new();
+	json_object *jobj = json_object_new_object();
+	gchar *ttl = g_strdup_printf("%ds", self->cache_ttl);
+	const gchar *text;
+
+	if (req->cache_op == GEMINI_CACHE_OP_CREATE) {
+		json_object *jcontents_array = json_object_new_array();
+		json_object *jcontent_obj = json_object_new_object();
+		json_object *jparts_array = json_object_new_array();
+		json_object *jtext_part = json_object_new_object();
+		gchar *model = g_strdup_printf("models/%s", req->model_name);
+
+		json_object_object_add(jtext_part, "text", json_object_new_string(req->prompt));
+		json_object_array_add(jparts_array, jtext_part);
+		json_object_object_add(jcontent_obj, "role", json_object_new_string("user"));
+		json_object_object_add(jcontent_obj, "parts", jparts_array);
+		json_object_array_add(jcontents_array, jcontent_obj);
+		json_object_object_add(jobj, "model", json_object_new_string(model));
+		json_object_object_add(jobj, "contents", jcontents_array);
+		g_free(model);
+	}
+	json_object_object_add(jobj, "ttl", json_object_new_string(ttl));
+
+	text = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_PLAIN);
+	gst_gemini_body_add_text(body, text, -1);
+	json_object_put(jobj);
+	g_free(ttl);
+	return body;
+}
+
+// Has the dispatcher create or extend the cached prompt
+static void
+queue_cache_request(GstGeminiVision *self, GeminiCacheOp op, const gchar *name) {
+	GeminiRequestData *req = g_new0(GeminiRequestData, 1);
+
+	req->cache_op = op;
+	req->self = self;
+	req->api_endpoint = g_strdup(self->api_endpoint);
+	req->api_key = g_strdup(self->api_key);
+	req->prompt = g_strdup(self->prompt);
+	req->model_name = g_strdup(self->model_name);
+	req->cached_content = g_strdup(name);
+	push_request(self, req);
+}
+
+// Copy of the name of the cached content holding the prompt, NULL while
+// there is none and the prompt is sent inline. Creating or extending it
+// as needed is left to the dispatcher, nothing waits for the API here.
+static gchar *
+prompt_cache_name(GstGeminiVision *self) {
+	const gint64 now = g_get_monotonic_time();
+	const gint64 ttl = (gint64) self->cache_ttl * G_TIME_SPAN_SECOND;
+	GeminiCacheOp op = GEMINI_CACHE_OP_NONE;
+	gchar *name;
+
+	GST_OBJECT_LOCK(self);
+	// Once expired the API has dropped it already
+	if (self->cache_name && now >= self->cache_expires) {
+		g_clear_pointer(&self->cache_name, g_free);
+	}
+	if (!self->cache_pending && now >= self->cache_retry_at) {
+		if (!self->cache_name) {
+			op = GEMINI_CACHE_OP_CREATE;
+		} else if (now >= self->cache_expires - ttl / 4) {
+			op = GEMINI_CACHE_OP_REFRESH;
+		}
+	}
+	self->cache_pending = self->cache_pending || op != GEMINI_CACHE_OP_NONE;
+	name = g_strdup(self->cache_name);
+	GST_OBJECT_UNLOCK(self);
+
+	if (op != GEMINI_CACHE_OP_NONE) {
+		queue_cache_request(self, op, name);
+	}
+	return name;
+}
+
+// Does the one-time work of the first analysis ahead of it
+static void
+run_prewarm(GstGeminiVision *self, GeminiRequestData *req) {
+	if (!req->original_buffer) {
+		push_request(self, req);
+		// The cached prompt is created now as well, on that connection
+		if (self->cache_prompt) {
+			g_free(prompt_cache_name(self));
+		}
+		return;
+	}
+
+	// Encoding a blank frame sets up the converter, scaler and stripe
+	// encoders for the caps and faults in their memory
+	if (encode_request(self, req)) {
+		GST_DEBUG_OBJECT(
+			self, 
+			"Encoder prewarmed for %dx%d", 
+			GST_VIDEO_INFO_WIDTH(&req->video_info), 
+			GST_VIDEO_INFO_HEIGHT(&req->video_info)
+		);
+	}
+	// The size of a blank frame says nothing about real ones
+	self->adaptive_quality = self->jpeg_quality;
+	gemini_request_data_free(req);
+}
+
+// --- Encoder Thread Function ---
+// Turns the frame referenced by each request into a JPEG and passes the
+// request on to the dispatcher. The streaming thread only takes a
+// reference to the buffer, the mapping and all pixel work happens here.
+static gpointer
+gemini_encoder_thread_func (gpointer data) {
+	GstGeminiVision *self = GST_GEMINI_VISION (data);
+	GeminiRequestData *req;
+
+	GST_DEBUG_OBJECT (self, "Encoder thread started.");
+
+	while (self->worker_running) {
+		req = g_async_queue_pop (self->encode_queue);
+
+		// Shutdown requests carry no buffer
+		if (!self->worker_running || (!req->original_buffer && !req->prewarm)) {
+			gemini_request_data_free(req);
+			continue;
+		}
+		if (req->prewarm) {
+			run_prewarm(self, req);
+			continue;
+		}
+		if (deadline_passed(req->deadline)) {
+			GST_DEBUG_OBJECT(self, "Frame waited past max-result-age, not encoding it");
+			push_result(self, req, NULL);
+			continue;
+		}
+		// A batch is answered as a whole, JPEG input would have to be decoded
+		if (self->description_cache_size > 0 && !req->batch && !req->is_jpeg && 
+			hash_request_frame(self, req)) {
+			gchar *description = lookup_description(self, req);
+
+			if (description) {
+				push_result(self, req, description);
+				continue;
+			}
+		}
+
+		gboolean ok = encode_request(self, req);
+
+		// The frames of a batch only go out together
+		for (guint i = 0; ok && req->batch && i < req->batch->len; i++) {
+			ok = encode_request(self, g_ptr_array_index(req->batch, i));
+		}
+		if (!ok) {
+			// Let the streaming thread pick another frame
+			push_result(self, req, NULL);
+			continue;
+		}
+		if (self->record) {
+			gchar *text = replay_response(self, req);
+
+			if (text) {
+				if (req->has_phash) {
+					store_description(self, req, text);
+				}
+				push_result(self, req, text);
+				continue;
+			}
+			if (self->record_mode == GST_GEMINI_RECORD_MODE_REPLAY) {
+				push_result(self, req, NULL);
+				continue;
+			}
+		}
+		if (self->cache_prompt) {
+			req->cached_content = prompt_cache_name(self);
+		}
+		push_request(self, req);
+	}
+
+	// Stripe threads only ever run on behalf of this thread
+	if (self->stripe_pool) {
+		g_thread_pool_free(self->stripe_pool, FALSE, TRUE);
+		self->stripe_pool = NULL;
+	}
+
+	GST_DEBUG_OBJECT (self, "Encoder thread finished.");
+	return NULL;
+}
+
+// --- Worker Thread Data Structures & Functions ---
+static const gchar *
+http_version_name(long version) {
+	switch (version) {
+		case CURL_HTTP_VERSION_1_0: return "HTTP/1.0";
+		case CURL_HTTP_VERSION_1_1: return "HTTP/1.1";
+		case CURL_HTTP_VERSION_2_0: return "HTTP/2";
+#if LIBCURL_VERSION_NUM >= 0x074200
+		case CURL_HTTP_VERSION_3: return "HTTP/3";
+#endif
+		default: return "unknown protocol";
+	}
+}
+
+// Logs where the time of a request went and how it was carried, and keeps
+// the protocol and stream count for the http-version and
+// max-streams-in-flight properties. All phases but the total are 0 when the
+// request reused a connection, which is what a persistent handle is for.
+// streams is the number of transfers that were running when this one
+// finished, over HTTP/2 they share one connection.
+static void
+log_transfer_timings(GstGeminiVision *self, CURL *handle, guint streams) {
+	curl_off_t dns = 0, connect = 0, tls = 0, first_byte = 0, total = 0;
+	long new_connections = 0, http_version = 0;
+	gboolean version_changed;
+
+	curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+	curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &tls);
+	curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+	curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+	curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &new_connections);
+	curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version);
+
+	GST_OBJECT_LOCK(self);
+	version_changed = http_version != self->http_version;
+	self->http_version = http_version;
+	self->max_streams = MAX(self->max_streams, streams);
+	GST_OBJECT_UNLOCK(self);
+
+	if (version_changed) {
+		GST_INFO_OBJECT(
+			self, 
+			"Negotiated %s with the API endpoint, %u request(s) in flight", 
+			http_version_name(http_version), 
+			streams
+		);
+	}
+
+	// The values are microseconds since the start of the request
+	GST_DEBUG_OBJECT(
+		self, 
+		"%s %s connection, %u request(s) in flight: dns %.1f ms, tcp %.1f ms, tls %.1f ms, first byte after %.1f ms, total %.1f ms", 
+		new_connections > 0 ? "New" : "Reused", 
+		http_version_name(http_version), 
+		streams, 
+		dns / 1000.0, 
+		MAX(connect - dns, 0) / 1000.0, 
+		MAX(tls - connect, 0) / 1000.0, 
+		first_byte / 1000.0, 
+		total / 1000.0
+	);
+}
+
+// Builds the JSON request for req. The image is not part of the JSON text,
+// its base64 is spliced in while curl sends the body.
+static GstGeminiBody *
+build_request_body(GstGeminiVision *self, GeminiRequestData *req_data) {
+    // Construct JSON payload correctly matching the API format
+    json_object *jobj = json_object_new_object();
+    json_object *jcontents_array = json_object_new_array();
+    json_object *jcontent_obj = json_object_new_object();
+    json_object *jparts_array = json_object_new_array();
+
+    // Image parts first (NOTE: order matters for Gemini). The frames of a
+    // batch are labelled with their timestamps, oldest first.
+    const guint n_images = 1 + (req_data->batch ? req_data->batch->len : 0);
+    for (guint i = 0; i < n_images; i++) {
+        GeminiRequestData *frame = i == 0 ? req_data : g_ptr_array_index(req_data->batch, i - 1);
+        GstClockTime pts = GST_BUFFER_PTS(frame->original_buffer);
+
+        if (n_images > 1) {
+            gchar *label = GST_CLOCK_TIME_IS_VALID(pts) ? 
+                g_strdup_printf("Frame %u at %.2f s:", i + 1, (gdouble) pts / GST_SECOND) : 
+                g_strdup_printf("Frame %u:", i + 1);
+            json_object *jlabel_part = json_object_new_object();
+            json_object_object_add(jlabel_part, "text", json_object_new_string(label));
+            json_object_array_add(jparts_array, jlabel_part);
+            g_free(label);
+        }
+
+        json_object *jimage_part = json_object_new_object();
+        json_object *jinline_data = json_object_new_object();
+        json_object_object_add(jinline_data, "mime_type", json_object_new_string("image/jpeg"));
+        json_object_object_add(jinline_data, "data", json_object_new_string(GEMINI_IMAGE_PLACEHOLDER));
+        json_object_object_add(jimage_part, "inline_data", jinline_data);
+        json_object_array_add(jparts_array, jimage_part);
+    }
+
+    // Last part: text prompt. A cached prompt comes before the contents.
+    if (n_images > 1) {
+        json_object *jtext_part = json_object_new_object();
+        gchar *prompt = g_strdup_printf(
+            "The images are %u frames of one video in time order. %s\n"
+            "Answer for each frame on its own, one description per frame in frame order.", 
+            n_images, 
+            req_data->cached_content ? "The instructions above apply to each of them." : req_data->prompt
+        );
+        json_object_object_add(jtext_part, "text", json_object_new_string(prompt));
+        json_object_array_add(jparts_array, jtext_part);
+        g_free(prompt);
+    } else if (!req_data->cached_content) {
+        json_object *jtext_part = json_object_new_object();
+        json_object_object_add(jtext_part, "text", json_object_new_string(req_data->prompt));
+        json_object_array_add(jparts_array, jtext_part);
+    }
+
+    // Complete the JSON structure
+    json_object_object_add(jcontent_obj, "parts", jparts_array);
+    json_object_array_add(jcontents_array, jcontent_obj);
+    json_object_object_add(jobj, "contents", jcontents_array);
+    if (req_data->cached_content) {
+        json_object_object_add(jobj, "cachedContent", json_object_new_string(req_data->cached_content));
+    }
+
+
+    // --- Add generationConfig ---
+    json_object *jgen_config = json_object_new_object();
+    gboolean gen_config_added = FALSE;
+
+    if (req_data->stop_sequences && req_data->stop_sequences[0] != NULL) {
+        json_object *jstop_seq_array = json_object_new_array();
+        for (int i = 0; req_data->stop_sequences[i] != NULL; i++) {
+            json_object_array_add(jstop_seq_array, json_object_new_string(req_data->stop_sequences[i]));
+        }
+        json_object_object_add(jgen_config, "stopSequences", jstop_seq_array);
+        gen_config_added = TRUE;
+    }
+    if (req_data->temperature >= 0.0) { // Assuming -1.0 is "not set"
+        json_object_object_add(jgen_config, "temperature", json_object_new_double(req_data->temperature));
+        gen_config_added = TRUE;
+    }
+    if (req_data->max_output_tokens > 0) { // Assuming 0 or -1 is "not set"
+        json_object_object_add(jgen_config, "maxOutputTokens", json_object_new_int(req_data->max_output_tokens));
+        gen_config_added = TRUE;
+    }
+    if (req_data->top_p >= 0.0) { // Assuming -1.0 is "not set"
+        json_object_object_add(jgen_config, "topP", json_object_new_double(req_data->top_p));
+        gen_config_added = TRUE;
+    }
+    if (req_data->top_k > 0) { // Assuming 0 or -1 is "not set"
+        json_object_object_add(jgen_config, "topK", json_object_new_int(req_data->top_k));
+        gen_config_added = TRUE;
+    }
+    if (n_images > 1) {
+        // Structured output keeps the descriptions of a batch apart
+        json_object *jschema = json_object_new_object();
+        json_object *jitems = json_object_new_object();
+        json_object_object_add(jitems, "type", json_object_new_string("STRING"));
+        json_object_object_add(jschema, "type", json_object_new_string("ARRAY"));
+        json_object_object_add(jschema, "items", jitems);
+        json_object_object_add(jgen_config, "responseMimeType", json_object_new_string("application/json"));
+        json_object_object_add(jgen_config, "responseSchema", jschema);
+        gen_config_added = TRUE;
+    }
+
+    if (gen_config_added) {
+        json_object_object_add(jobj, "generationConfig", jgen_config);
+    } else {
+        json_object_put(jgen_config); // Not used, free it
+    }
+    // --- End generationConfig ---
+
+    const char *json_string = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_PLAIN);
+    GST_DEBUG_OBJECT(self, "Sending JSON: %s", json_string);
+
+    // The image parts come first, so the first placeholders are the ones
+    // we put there even if the prompt happens to contain the same text.
+    // Their base64 is produced in curl's upload buffer, so the request
+    // never holds a second copy of an image.
+    const char *text = json_string;
+    GstGeminiBody *body = gst_gemini_body_new();
+    for (guint i = 0; i < n_images; i++) {
+        GeminiRequestData *frame = i == 0 ? req_data : g_ptr_array_index(req_data->batch, i - 1);
+        const char *image_at = strstr(text, "\"" GEMINI_IMAGE_PLACEHOLDER "\"") + 1;
+
+        gst_gemini_body_add_text(body, text, image_at - text);
+        if (!gst_gemini_body_add_base64(body, frame->image)) {
+            GST_ERROR_OBJECT(self, "Failed to map image data.");
+            gst_gemini_body_free(body);
+            body = NULL;
+            break;
+        }
+        text = image_at + strlen(GEMINI_IMAGE_PLACEHOLDER);
+    }
+    if (body) {
+        gst_gemini_body_add_text(body, text, -1);
+    }
+
+    json_object_put(jobj); // Free our request json-c object
+    return body;
+}
+
+// One request being sent or received by the worker's multi handle. Once
+// done the transfer is parked with its easy handle and response buffers
+// and taken up again by a later request.
+typedef struct {
+	GeminiRequestData *req;     // NULL while parked
+	CURL *handle;
+	GstGeminiBody *body;
+	struct curl_slist *headers;
+	GstGeminiResponse *response;
+	GString *reply;             // Answer to a cached prompt request, which is not parsed as it comes
+	gsize received;             // Bytes of the response so far
+	gboolean format_known;      // is_sse has been decided
+	gboolean is_sse;            // The response is an event stream
+	gsize partial_len;          // Length of the text last passed on as partial
+	gint attempt;               // Retries made so far
+	gint64 retry_at;            // Monotonic time of the next attempt
+} GeminiTransfer;
+
+static GeminiTransfer *
+gemini_transfer_new(void) {
+	GeminiTransfer *transfer = g_new0(GeminiTransfer, 1);
+
+	transfer->handle = curl_easy_init();
+	if (!transfer->handle) {
+		g_free(transfer);
+		return NULL;
+	}
+	transfer->response = gst_gemini_response_new();
+	transfer->reply = g_string_new(NULL);
+	curl_easy_setopt(transfer->handle, CURLOPT_PRIVATE, transfer);
+	return transfer;
+}
+
+// Forgets the response of an attempt, the request stays set up for the next
+static void
+gemini_transfer_rewind(GeminiTransfer *transfer) {
+	gst_gemini_response_reset(transfer->response);
+	g_string_truncate(transfer->reply, 0);
+	transfer->received = 0;
+	transfer->format_known = FALSE;
+	transfer->is_sse = FALSE;
+	transfer->partial_len = 0;
+}
+
+// Releases what belongs to the request and readies the transfer for the
+// next one
+static void
+gemini_transfer_clear(GeminiTransfer *transfer) {
+	if (transfer->req) gemini_request_data_free(transfer->req);
+	transfer->req = NULL;
+	curl_slist_free_all(transfer->headers);
+	transfer->headers = NULL;
+	gst_gemini_body_free(transfer->body); // Unmaps the image
+	transfer->body = NULL;
+	gemini_transfer_rewind(transfer);
+	transfer->attempt = 0;
+	// curl_easy_reset() clears the options but keeps the handle's caches
+	curl_easy_reset(transfer->handle);
+	curl_easy_setopt(transfer->handle, CURLOPT_PRIVATE, transfer);
+}
+
+static void
+gemini_transfer_free(GeminiTransfer *transfer) {
+	gemini_transfer_clear(transfer);
+	curl_easy_cleanup(transfer->handle);
+	gst_gemini_response_free(transfer->response);
+	g_string_free(transfer->reply, TRUE);
+	g_free(transfer);
+}
 
-typedef struct {
-	unsigned char *data;
-	unsigned long size;
-	unsigned long allocated_size;
-} JPEGDynamicBuffer;
+// CURLOPT_WRITEFUNCTION, hands the bytes straight to the response parser.
+// Streamed text is passed on each time an event completes.
+static size_t
+ResponseWriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+	GeminiTransfer *transfer = (GeminiTransfer *)userp;
+	GstGeminiVision *self = transfer->req->self;
+	const size_t realsize = size * nmemb;
+	const gchar *data = contents;
+	gsize left = realsize;
+
+	GST_LOG_OBJECT(self, "API Response: %.*s", (int) realsize, data);
+	transfer->received += realsize;
+
+	if (transfer->req->cache_op != GEMINI_CACHE_OP_NONE) {
+		g_string_append_len(transfer->reply, data, realsize);
+		return realsize;
+	}
+	if (!transfer->format_known) {
+		// Errors are plain JSON even when an event stream was asked for
+		char *content_type = NULL;
+		curl_easy_getinfo(transfer->handle, CURLINFO_CONTENT_TYPE, &content_type);
+		transfer->is_sse = transfer->req->stream && content_type && 
+			g_ascii_strncasecmp(content_type, "text/event-stream", 17) == 0;
+		transfer->format_known = TRUE;
+	}
+
+	if (!transfer->is_sse) {
+		gst_gemini_response_feed(transfer->response, data, realsize);
+		return realsize;
+	}
+
+	while (left > 0) {
+		gboolean event_end;
+		gsize n = gst_gemini_response_feed_sse(transfer->response, data, left, &event_end);
+		const gchar *text = gst_gemini_response_get_text(transfer->response);
+
+		data += n;
+		left -= n;
+		// Regions are only delivered complete, like their metadata, and
+		// the answer to a batch is only split once it is complete
+		if (event_end && text && !transfer->req->has_roi && !transfer->req->batch && strlen(text) > transfer->partial_len) {
+			transfer->partial_len = strlen(text);
+			push_partial(self, transfer->req, text);
+		}
+	}
+	return realsize;
+}
+
+// Turns a complete response into the description to deliver
+static gchar *
+describe_response(GstGeminiVision *self, GeminiTransfer *transfer) {
+	const GstGeminiResponse *response = transfer->response;
+	const gchar *error = gst_gemini_response_get_error(response);
+	const gchar *text = gst_gemini_response_get_text(response);
+	const gchar *finish_reason = gst_gemini_response_get_finish_reason(response);
+	gint64 prompt_tokens, candidates_tokens, total_tokens;
+	gint64 cached_tokens = gst_gemini_response_get_cached_tokens(response);
 
+	GST_DEBUG_OBJECT(self, "%lu bytes retrieved from API", (unsigned long)transfer->received);
+	if (gst_gemini_response_get_usage(response, &prompt_tokens, &candidates_tokens, &total_tokens)) {
+		GST_DEBUG_OBJECT(
+			self, 
+			"Finish reason %s, tokens: %" G_GINT64_FORMAT " prompt (%" G_GINT64_FORMAT " cached), %" G_GINT64_FORMAT " candidates, %" G_GINT64_FORMAT " total", 
+			finish_reason ? finish_reason : "unknown", 
+			prompt_tokens, 
+			MAX(cached_tokens, 0), 
+			candidates_tokens, 
+			total_tokens
+		);
+	}
+
+	// Handle API error responses
+	if (error) {
+		if (error[0] != '\0') {
+			GST_WARNING_OBJECT(self, "Gemini API Error: %s", error);
+			return g_strdup(error);
+		}
+		GST_WARNING_OBJECT(self, "Gemini API returned an error without a message");
+		return g_strdup("No description found.");
+	}
+	if (!text) {
+		GST_WARNING_OBJECT(
+			self, 
+			"Could not %s Gemini response or find text", 
+			gst_gemini_response_is_valid(response) ? "find text in" : "parse"
+		);
+		return g_strdup("No description found.");
+	}
+	if (finish_reason && g_strcmp0(finish_reason, "STOP") != 0) {
+		GST_INFO_OBJECT(self, "Description ended early: %s", finish_reason);
+	}
+	return g_strdup(text);
+}
+
+// Lets curl abort the transfer when the request's deadline passes
 static void
-jpeg_init_destination(j_compress_ptr cinfo) {
-	JPEGDynamicBuffer *dest = (JPEGDynamicBuffer*) cinfo->client_data;
-	dest->data = g_malloc(16384);  // Initial buffer size
-	dest->allocated_size = 16384;
-	dest->size = 0;
-
-	cinfo->dest->next_output_byte = dest->data;
-	cinfo->dest->free_in_buffer = dest->allocated_size;
-}
-
-static boolean
-jpeg_empty_output_buffer(j_compress_ptr cinfo) {
-	JPEGDynamicBuffer *dest = (JPEGDynamicBuffer*) cinfo->client_data;
-	unsigned int new_size = dest->allocated_size * 2;
-	unsigned char *new_buffer = g_realloc(dest->data, new_size);
-
-	if (!new_buffer) {
-		// Instead of ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-		// Use the standard error reporting method
-		(*cinfo->err->error_exit)((j_common_ptr)cinfo);
+set_transfer_deadline(GeminiTransfer *transfer) {
+	gint64 remaining;
+
+	if (transfer->req->deadline == 0) {
+		return;
+	}
+	remaining = transfer->req->deadline - g_get_monotonic_time();
+	curl_easy_setopt(
+		transfer->handle, 
+		CURLOPT_TIMEOUT_MS, 
+		(long) MAX(remaining / G_TIME_SPAN_MILLISECOND, 1)
+	);
+}
+
+// Adds the request to the multi handle. Parked transfers are reused with
+// their easy handles, the connections themselves are cached by the multi
+// handle. Returns FALSE if the request ended without being sent.
+static gboolean
+start_transfer(GeminiDispatcher *dispatcher, GeminiRequestData *req) {
+	GstGeminiVision *self = req->self;
+	GeminiTransfer *transfer;
+
+	if (req->prewarm) {
+		GST_DEBUG_OBJECT(self, "Worker connecting ahead of the first request");
+	} else if (req->cache_op != GEMINI_CACHE_OP_NONE) {
+		GST_DEBUG_OBJECT(
+			self, 
+			"Worker %s the cached prompt", 
+			req->cache_op == GEMINI_CACHE_OP_CREATE ? "creating" : "extending"
+		);
+	} else {
+		GST_DEBUG_OBJECT (
+			self, 
+			"Worker processing request for buffer PTS %" GST_TIME_FORMAT,
+			GST_TIME_ARGS(GST_BUFFER_PTS(req->original_buffer))
+		);
+	}
+
+	if (deadline_passed(req->deadline)) {
+		GST_DEBUG_OBJECT(self, "Request waited past max-result-age, not sending it");
+		push_result(self, req, NULL);
+		return FALSE;
+	}
+	transfer = g_queue_pop_head(&dispatcher->idle_transfers);
+	if (!transfer && !(transfer = gemini_transfer_new())) {
+		GST_ERROR_OBJECT(self, "Failed to create a curl handle");
+		push_result(self, req, NULL);
+		return FALSE;
+	}
+	if (req->cache_op != GEMINI_CACHE_OP_NONE) {
+		transfer->body = build_cache_body(self, req);
+	} else if (!req->prewarm && !(transfer->body = build_request_body(self, req))) {
+		push_result(self, req, NULL);
+		g_queue_push_head(&dispatcher->idle_transfers, transfer);
 		return FALSE;
 	}
+	transfer->req = req;
+
+	// Set up CURL
+	char *api_url;
+	if (req->prewarm) {
+		// Reading the model's metadata uses no quota, and it tells early
+		// whether the key and model name are accepted
+		api_url = g_strdup_printf(
+			"%s/models/%s?key=%s", 
+			req->api_endpoint, 
+			req->model_name, 
+			req->api_key
+		);
+	} else if (req->cache_op == GEMINI_CACHE_OP_CREATE) {
+		api_url = g_strdup_printf("%s/cachedContents?key=%s", req->api_endpoint, req->api_key);
+	} else if (req->cache_op == GEMINI_CACHE_OP_REFRESH) {
+		api_url = g_strdup_printf(
+			"%s/%s?updateMask=ttl&key=%s", 
+			req->api_endpoint, 
+			req->cached_content, 
+			req->api_key
+		);
+	} else {
+		api_url = g_strdup_printf(
+			"%s/models/%s:%s%s", 
+			req->api_endpoint, 
+			req->model_name, 
+			req->stream ? "streamGenerateContent?alt=sse&key=" : "generateContent?key=", 
+			req->api_key
+		);
+	}
+	curl_easy_setopt(transfer->handle, CURLOPT_URL, api_url);
+	g_free(api_url); // Free the URL string
+	if (transfer->body) {
+		gst_gemini_body_attach(transfer->body, transfer->handle);
+	}
+	if (req->cache_op == GEMINI_CACHE_OP_REFRESH) {
+		curl_easy_setopt(transfer->handle, CURLOPT_CUSTOMREQUEST, "PATCH");
+	}
+
+	transfer->headers = curl_slist_append(transfer->headers, "Content-Type: application/json");
+	// curl would otherwise hold a large body back until the server
+	// answers "100 Continue", a full round trip per request
+	transfer->headers = curl_slist_append(transfer->headers, "Expect:");
+	curl_easy_setopt(transfer->handle, CURLOPT_HTTPHEADER, transfer->headers);
 
-	dest->data = new_buffer;
-	cinfo->dest->next_output_byte = dest->data + dest->allocated_size;
-	cinfo->dest->free_in_buffer = dest->allocated_size;
-	dest->allocated_size = new_size;
+	curl_easy_setopt(transfer->handle, CURLOPT_WRITEFUNCTION, ResponseWriteCallback);
+	curl_easy_setopt(transfer->handle, CURLOPT_WRITEDATA, (void *)transfer);
+	// Keep the idle connection alive between analyses
+	curl_easy_setopt(transfer->handle, CURLOPT_TCP_KEEPALIVE, 1L);
+	// Offer HTTP/2 during the TLS handshake, and while that connection is
+	// being set up let further requests wait for it to carry them as
+	// streams instead of opening a connection each
+	curl_easy_setopt(transfer->handle, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(transfer->handle, CURLOPT_PIPEWAIT, 1L);
+	set_transfer_deadline(transfer);
+	if (req->cache_op != GEMINI_CACHE_OP_NONE) {
+		// Requests carry the prompt themselves until this ends
+		curl_easy_setopt(
+			transfer->handle, 
+			CURLOPT_TIMEOUT_MS, 
+			(long) (GEMINI_CACHE_TIMEOUT / G_TIME_SPAN_MILLISECOND)
+		);
+	}
 
+	curl_multi_add_handle(dispatcher->multi, transfer->handle);
+	g_ptr_array_add(dispatcher->transfers, transfer);
 	return TRUE;
 }
 
+// Sends a transfer waiting for a retry again
 static void
-jpeg_term_destination(j_compress_ptr cinfo) {
-	JPEGDynamicBuffer *dest = (JPEGDynamicBuffer*) cinfo->client_data;
-	dest->size = dest->allocated_size - cinfo->dest->free_in_buffer;
+restart_transfer(GeminiDispatcher *dispatcher, GeminiTransfer *transfer) {
+	// The body is read from the start again, everything else is still set
+	gst_gemini_body_attach(transfer->body, transfer->handle);
+	set_transfer_deadline(transfer);
+	curl_multi_add_handle(dispatcher->multi, transfer->handle);
+	g_ptr_array_add(dispatcher->transfers, transfer);
+}
+
+static gint
+compare_retry_time(gconstpointer a, gconstpointer b, gpointer user_data) {
+	const GeminiTransfer *ta = a, *tb = b;
+
+	return ta->retry_at < tb->retry_at ? -1 : ta->retry_at > tb->retry_at;
 }
 
-// Function to encode raw video frame to JPEG
+// Whether an attempt that failed this way may succeed when sent again
 static gboolean
-encode_frame_to_jpeg(
-	GstGeminiVision *self, 
-	GstMapInfo *map_info, 
-    unsigned char **jpeg_buffer, 
-	unsigned long *jpeg_size
-) {
-	struct jpeg_compress_struct cinfo;
-	struct jpeg_error_mgr jerr;
-	JSAMPROW row_pointer[1];
-	int row_stride;
-	JPEGDynamicBuffer dest_buffer = {NULL, 0, 0};
-	struct jpeg_destination_mgr dest_mgr = {
-		jpeg_init_destination,
-		jpeg_empty_output_buffer,
-		jpeg_term_destination
-  	};
-  
-	// Safety checks
-	if (!map_info || !map_info->data || map_info->size == 0) {
-		GST_ERROR_OBJECT(self, "Invalid map info or buffer data");
+is_retryable(CURLcode res, long status) {
+	switch (res) {
+		case CURLE_OK:
+			// Timeout, quota exceeded and server side failures
+			return status == 408 || status == 429 || status == 500 || 
+				status == 502 || status == 503 || status == 504;
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_SSL_CONNECT_ERROR:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+		case CURLE_GOT_NOTHING:
+		case CURLE_PARTIAL_FILE:
+		case CURLE_HTTP2:
+		case CURLE_HTTP2_STREAM:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+// Describes a failed attempt for the log
+static gchar *
+describe_failure(GeminiTransfer *transfer, CURLcode res, long status) {
+	const gchar *error;
+
+	if (res != CURLE_OK) {
+		return g_strdup(curl_easy_strerror(res));
+	}
+	error = gst_gemini_response_get_error(transfer->response);
+	return g_strdup_printf("HTTP %ld%s%s", status, error && error[0] ? ": " : "", error ? error : "");
+}
+
+// The quota is shared by everything the dispatcher sends: no request of any
+// of its elements starts before until, and the elements analyze no new
+// frames until then either
+static void
+back_off(GeminiDispatcher *dispatcher, gint64 until) {
+	dispatcher->backoff_until = MAX(dispatcher->backoff_until, until);
+
+	g_mutex_lock(&dispatcher->lock);
+	for (guint i = 0; i < dispatcher->clients->len; i++) {
+		GstGeminiVision *self = ((GeminiClient *) g_ptr_array_index(dispatcher->clients, i))->self;
+
+		GST_OBJECT_LOCK(self);
+		self->backoff_until = MAX(self->backoff_until, until);
+		GST_OBJECT_UNLOCK(self);
+	}
+	g_mutex_unlock(&dispatcher->lock);
+}
+
+// Queues the transfer to be sent again after a backoff, keeping retries
+// ordered by due time. Retry-After from the server wins over our own
+// backoff, and after a 429 no new analysis starts before the retry is due.
+// Returns FALSE if the server asked to wait longer than we are willing to.
+static gboolean
+schedule_retry(GeminiDispatcher *dispatcher, GeminiTransfer *transfer, long status, const gchar *reason) {
+	GstGeminiVision *self = transfer->req->self;
+	curl_off_t retry_after = 0;
+	gint64 delay = MIN(GEMINI_RETRY_BASE_DELAY << transfer->attempt, GEMINI_RETRY_MAX_DELAY);
+
+	// Equal jitter: at least half the backoff, the rest random
+	delay = delay / 2 + (gint64) g_random_double_range(0, delay / 2);
+	curl_easy_getinfo(transfer->handle, CURLINFO_RETRY_AFTER, &retry_after);
+	if (retry_after > 0) {
+		delay = retry_after * G_TIME_SPAN_SECOND;
+	}
+	transfer->retry_at = g_get_monotonic_time() + delay;
+
+	if (status == 429 || retry_after > 0) {
+		back_off(dispatcher, transfer->retry_at);
+	}
+	if (transfer->req->deadline != 0 && transfer->retry_at >= transfer->req->deadline) {
+		GST_DEBUG_OBJECT(self, "Request failed with %s, a retry would exceed max-result-age", reason);
 		return FALSE;
 	}
-  
-	if (self->input_video_info.width <= 0 || self->input_video_info.height <= 0) {
-		GST_ERROR_OBJECT(
+	if (delay > GEMINI_RETRY_MAX_DELAY) {
+		GST_WARNING_OBJECT(
 			self, 
-			"Invalid video dimensions: %dx%d", 
-			self->input_video_info.width, self->input_video_info.height
+			"Request failed with %s, server asks to wait %" G_GINT64_FORMAT " s, giving up", 
+			reason, 
+			(gint64) retry_after
 		);
 		return FALSE;
 	}
-  
-	GstVideoFormat format = self->input_video_info.finfo->format;
-	const char *format_name = gst_video_format_to_string(format);
-	GST_DEBUG_OBJECT(
+
+	transfer->attempt++;
+	GST_WARNING_OBJECT(
 		self, 
-		"Encoding video format %s to JPEG, dimensions: %dx%d", 
-		format_name, self->input_video_info.width, self->input_video_info.height
+		"Request failed with %s, retry %d of %d in %.1f s", 
+		reason, 
+		transfer->attempt, 
+		transfer->req->max_retries, 
+		delay / (gdouble) G_TIME_SPAN_SECOND
 	);
-  
-	// Verify we have enough data for the frame
-	gsize expected_size = self->input_video_info.size;
-	if (map_info->size < expected_size) {
-		GST_ERROR_OBJECT(
+	gemini_transfer_rewind(transfer);
+	g_queue_insert_sorted(&dispatcher->retries, transfer, compare_retry_time, NULL);
+	return TRUE;
+}
+
+// The connection stays in the pool for the first request. A key or model
+// the API rejects would fail every analysis, so that is posted right away.
+static void
+report_prewarm(GstGeminiVision *self, GeminiTransfer *transfer, CURLcode res, long status) {
+	gchar *reason;
+
+	if (res == CURLE_OK && status >= 200 && status < 300) {
+		GST_INFO_OBJECT(self, "Connected to the API ahead of the first request");
+		return;
+	}
+	reason = describe_failure(transfer, res, status);
+	if (res == CURLE_OK && status >= 400 && status < 500 && status != 408 && status != 429) {
+		GST_ELEMENT_WARNING(
 			self, 
-			"Buffer too small: got %zu bytes, expected %zu bytes",
-			map_info->size, expected_size
+			RESOURCE, 
+			READ, 
+			("Gemini API rejected the model or API key"), 
+			("%s", reason)
 		);
-		return FALSE;
+	} else {
+		GST_WARNING_OBJECT(self, "Could not connect ahead of the first request: %s", reason);
 	}
-  
-	// Set up JPEG compression with error handling
-	memset(&cinfo, 0, sizeof(cinfo));
-	memset(&jerr, 0, sizeof(jerr));
-	cinfo.err = jpeg_std_error(&jerr);
-	
-	// Create the compressor
-	jpeg_create_compress(&cinfo);
-	
-	// Set up dynamic memory destination
-	dest_buffer.data = NULL;
-	dest_buffer.size = 0;
-	dest_buffer.allocated_size = 0;
-	
-	dest_mgr.init_destination = jpeg_init_destination;
-	dest_mgr.empty_output_buffer = jpeg_empty_output_buffer;
-	dest_mgr.term_destination = jpeg_term_destination;
-	
-	cinfo.client_data = &dest_buffer;
-	cinfo.dest = &dest_mgr;
-	
-	// Set JPEG parameters
-	cinfo.image_width = self->input_video_info.width;
-	cinfo.image_height = self->input_video_info.height;
-	
-	// Get stride information
-	int n_components;
-	J_COLOR_SPACE color_space;
-  
-	// Handle various formats - focus on common RGB formats for Gemini
-	switch (format) {
-		case GST_VIDEO_FORMAT_RGB:
-			n_components = 3;
-			color_space = JCS_RGB;
-			break;
-		case GST_VIDEO_FORMAT_BGR:
-			n_components = 3;
-			color_space = JCS_RGB; // We'll need to convert BGR->RGB
-			break;
-		case GST_VIDEO_FORMAT_RGBA:
-		case GST_VIDEO_FORMAT_BGRA:
-			n_components = 3; // We'll skip the alpha channel
-			color_space = JCS_RGB;
-			break;
-		case GST_VIDEO_FORMAT_I420:
-		case GST_VIDEO_FORMAT_YV12:
-		case GST_VIDEO_FORMAT_NV12:
-		case GST_VIDEO_FORMAT_NV21:
-			// For YUV formats, we should convert to RGB first
-			GST_ERROR_OBJECT(self, "YUV formats not directly supported. Please add videoconvert before this element");
-			return FALSE;
-		default:
-			GST_ERROR_OBJECT(self, "Unsupported video format for JPEG encoding: %s", format_name);
-			return FALSE;
+	g_free(reason);
+}
+
+// Takes the name or the new expiry of the cached prompt from the answer.
+// The TTL is counted from when the request was sent. After a failure the
+// prompt is sent inline, or the cached content used until it expires, for
+// a while before trying again.
+static void
+finish_cache_request(GstGeminiVision *self, GeminiTransfer *transfer, CURLcode res, long status) {
+	const gboolean create = transfer->req->cache_op == GEMINI_CACHE_OP_CREATE;
+	const gchar *action = create ? "create" : "extend";
+	const gint64 now = g_get_monotonic_time();
+	curl_off_t total = 0;
+	gchar *name = NULL;
+	gboolean ok = FALSE;
+
+	if (res != CURLE_OK) {
+		GST_WARNING_OBJECT(self, "Could not %s the cached prompt: %s", action, curl_easy_strerror(res));
+	} else if (status < 200 || status >= 300) {
+		warn_cache_refused(self, action, status, transfer->reply);
+	} else if (create) {
+		json_object *jroot = json_tokener_parse(transfer->reply->str);
+		json_object *jname;
+
+		if (jroot && json_object_object_get_ex(jroot, "name", &jname) && 
+			json_object_is_type(jname, json_type_string)) {
+			name = g_strdup(json_object_get_string(jname));
+			ok = TRUE;
+			GST_INFO_OBJECT(self, "Cached the prompt as %s for %d s", name, self->cache_ttl);
+		} else {
+			GST_WARNING_OBJECT(self, "The cached prompt was created without a name");
+		}
+		json_object_put(jroot);
+	} else {
+		ok = TRUE;
+		GST_DEBUG_OBJECT(self, "Extended %s by %d s", transfer->req->cached_content, self->cache_ttl);
 	}
-  
-	cinfo.input_components = n_components;
-	cinfo.in_color_space = color_space;
-	
-	jpeg_set_defaults(&cinfo);
-	jpeg_set_quality(&cinfo, 85, TRUE); // 85% quality
-	
-	// Start compression
-	jpeg_start_compress(&cinfo, TRUE);
-	
-	// Get row stride - use actual stride from videoinfo
-	row_stride = GST_VIDEO_INFO_PLANE_STRIDE(&self->input_video_info, 0);
-	GST_DEBUG_OBJECT(self, "Video stride: %d, components: %d", row_stride, n_components);
-	
-	// Allocate temporary buffer for row if we need format conversion
-	guchar *rgb_row = NULL;
-	if (format == GST_VIDEO_FORMAT_BGR || format == GST_VIDEO_FORMAT_BGRA || format == GST_VIDEO_FORMAT_RGBA) {
-		rgb_row = g_malloc(self->input_video_info.width * 3); // RGB buffer
+	curl_easy_getinfo(transfer->handle, CURLINFO_TOTAL_TIME_T, &total);
+
+	GST_OBJECT_LOCK(self);
+	if (ok) {
+		if (create) {
+			g_free(self->cache_name);
+			self->cache_name = name;
+		}
+		self->cache_expires = now - total + (gint64) self->cache_ttl * G_TIME_SPAN_SECOND;
+	} else {
+		self->cache_retry_at = now + GEMINI_CACHE_RETRY_DELAY;
 	}
-  
-	// Process image data row by row
-	while (cinfo.next_scanline < cinfo.image_height) {
-		guchar *src_row = map_info->data + (cinfo.next_scanline * row_stride);
-		
-		// Handle conversions if needed
-		if (format == GST_VIDEO_FORMAT_BGR) {
-			// Convert BGR -> RGB
-			for (int i = 0; i < self->input_video_info.width; i++) {
-				rgb_row[i*3 + 0] = src_row[i*3 + 2]; // R <- B
-				rgb_row[i*3 + 1] = src_row[i*3 + 1]; // G <- G
-				rgb_row[i*3 + 2] = src_row[i*3 + 0]; // B <- R
-			}
-			row_pointer[0] = rgb_row;
-		}
-		else if (format == GST_VIDEO_FORMAT_RGBA) {
-			// Skip alpha channel in RGBA
-			for (int i = 0; i < self->input_video_info.width; i++) {
-				rgb_row[i*3 + 0] = src_row[i*4 + 0]; // R
-				rgb_row[i*3 + 1] = src_row[i*4 + 1]; // G
-				rgb_row[i*3 + 2] = src_row[i*4 + 2]; // B
+	GST_OBJECT_UNLOCK(self);
+}
+
+// Turns a finished transfer into a result and parks it, or queues it for
+// another attempt
+static void
+finish_transfer(GeminiDispatcher *dispatcher, CURL *handle, CURLcode res) {
+	GstGeminiVision *self;
+	GeminiTransfer *transfer = NULL;
+	gchar *description = NULL;
+	long status = 0;
+
+	curl_easy_getinfo(handle, CURLINFO_PRIVATE, (char **) &transfer);
+	self = transfer->req->self;
+	curl_multi_remove_handle(dispatcher->multi, handle);
+	log_transfer_timings(self, handle, dispatcher->transfers->len);
+	g_ptr_array_remove_fast(dispatcher->transfers, transfer);
+
+	if (res == CURLE_OK) {
+		gst_gemini_response_finish(transfer->response);
+		curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+	}
+
+	if (transfer->req->prewarm) {
+		report_prewarm(self, transfer, res, status);
+	} else if (transfer->req->cache_op != GEMINI_CACHE_OP_NONE) {
+		finish_cache_request(self, transfer, res, status);
+	} else if (res == CURLE_OK && status >= 200 && status < 300) {
+		const gchar *text = gst_gemini_response_get_text(transfer->response);
+
+		description = describe_response(self, transfer);
+		if (text && !gst_gemini_response_get_error(transfer->response)) {
+			if (transfer->req->has_phash) {
+				store_description(self, transfer->req, text);
 			}
-			row_pointer[0] = rgb_row;
-		}
-		else if (format == GST_VIDEO_FORMAT_BGRA) {
-			// Convert BGRA -> RGB (skip alpha channel)
-			for (int i = 0; i < self->input_video_info.width; i++) {
-				rgb_row[i*3 + 0] = src_row[i*4 + 2]; // R <- B
-				rgb_row[i*3 + 1] = src_row[i*4 + 1]; // G <- G
-				rgb_row[i*3 + 2] = src_row[i*4 + 0]; // B <- R
+			if (transfer->req->has_record_key) {
+				record_response(self, transfer->req, text);
 			}
-			row_pointer[0] = rgb_row;
 		}
-		else {
-			// RGB or other direct format
-			row_pointer[0] = src_row;
+	} else if (deadline_passed(transfer->req->deadline)) {
+		// curl aborted it at the deadline, a late answer is of no use
+		GST_DEBUG_OBJECT(self, "Request exceeded max-result-age, dropping it");
+	} else {
+		// Error bodies are not descriptions, the request fails unless a
+		// retry can still make it
+		gchar *reason = describe_failure(transfer, res, status);
+		gboolean retried = is_retryable(res, status) && 
+			transfer->attempt < transfer->req->max_retries && 
+			schedule_retry(dispatcher, transfer, status, reason);
+
+		if (!retried) {
+			GST_ELEMENT_WARNING(
+				self, 
+				RESOURCE, 
+				READ, 
+				("Gemini request failed"), 
+				("%s after %d attempt(s)", reason, transfer->attempt + 1)
+			);
 		}
-		
-		if (jpeg_write_scanlines(&cinfo, row_pointer, 1) != 1) {
-			GST_ERROR_OBJECT(self, "Error writing JPEG scanline");
-			if (rgb_row) g_free(rgb_row);
-			jpeg_destroy_compress(&cinfo);
-			if (dest_buffer.data) g_free(dest_buffer.data);
-			return FALSE;
+		g_free(reason);
+		if (retried) {
+			return;
 		}
 	}
-  
-	// Free temporary row buffer if allocated
-	if (rgb_row) g_free(rgb_row);
-	
-	// Finish compression
-	jpeg_finish_compress(&cinfo);
-	jpeg_destroy_compress(&cinfo);
-	
-	// Set output parameters
-	*jpeg_buffer = dest_buffer.data;
-	*jpeg_size = dest_buffer.size;
-	
-	GST_DEBUG_OBJECT(
-		self, 
-		"Successfully encoded JPEG image (%lu bytes)", 
-		dest_buffer.size
-	);
-	return TRUE;
+	push_result(self, transfer->req, description);
+	transfer->req = NULL;
+
+	gemini_transfer_clear(transfer);
+	g_queue_push_head(&dispatcher->idle_transfers, transfer);
 }
 
-// --- Worker Thread Data Structures & Functions ---
-typedef struct {
-	gchar *data;
-	size_t size;
-} MemoryStruct;
+// --- Dispatcher Thread Function ---
+// Whether the limits let another transfer start now. If max_rpm does not,
+// wake_at is moved to when the oldest start leaves the window. A transfer
+// slot frees up with a finished transfer, which wakes the loop anyway.
+static gboolean
+may_start_transfer(GeminiDispatcher *dispatcher, gint64 now, gint64 *wake_at) {
+	GArray *times = dispatcher->request_times;
+	guint expired = 0;
 
-static size_t
-WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    MemoryStruct *mem = (MemoryStruct *)userp;
-
-    gchar *ptr = g_realloc(mem->data, mem->size + realsize + 1);
-    if (ptr == NULL) {
-        GST_ERROR("not enough memory (realloc returned NULL)");
-        return 0;
-    }
+	if (dispatcher->max_transfers > 0 && dispatcher->transfers->len >= (guint) dispatcher->max_transfers) {
+		return FALSE;
+	}
+	while (expired < times->len && g_array_index(times, gint64, expired) <= now - G_TIME_SPAN_MINUTE) {
+		expired++;
+	}
+	g_array_remove_range(times, 0, expired);
+	if (dispatcher->max_rpm == 0 || times->len < (guint) dispatcher->max_rpm) {
+		return TRUE;
+	}
+	*wake_at = MIN(*wake_at, g_array_index(times, gint64, 0) + G_TIME_SPAN_MINUTE);
+	return FALSE;
+}
+
+// Takes the next request, from the element of the highest priority that has
+// one and among those from the next after the one served last
+static GeminiRequestData *
+next_request(GeminiDispatcher *dispatcher) {
+	GeminiClient *best = NULL;
+	guint n = dispatcher->clients->len, best_index = 0;
+
+	for (guint k = 0; k < n; k++) {
+		guint i = (dispatcher->next_client + k) % n;
+		GeminiClient *client = g_ptr_array_index(dispatcher->clients, i);
+
+		if (!g_queue_is_empty(&client->pending) && (!best || client->priority > best->priority)) {
+			best = client;
+			best_index = i;
+		}
+	}
+	if (!best) {
+		return NULL;
+	}
+	dispatcher->next_client = best_index + 1;
+	return g_queue_pop_head(&best->pending);
+}
 
-    mem->data = ptr;
-    memcpy(&(mem->data[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->data[mem->size] = 0; // Null-terminate
-    return realsize;
+static gboolean
+was_removed(GeminiDispatcher *dispatcher, GeminiTransfer *transfer) {
+	for (guint i = 0; i < dispatcher->removed->len; i++) {
+		if (g_ptr_array_index(dispatcher->removed, i) == transfer->req->self) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Drops the transfers of elements that stopped and lets them go on, called
+// with the lock held
+static void
+drop_removed_clients(GeminiDispatcher *dispatcher) {
+	GeminiTransfer *transfer;
+	GList *link, *next;
+
+	if (dispatcher->removed->len == 0) {
+		return;
+	}
+	for (guint i = dispatcher->transfers->len; i-- > 0;) {
+		transfer = g_ptr_array_index(dispatcher->transfers, i);
+		if (was_removed(dispatcher, transfer)) {
+			curl_multi_remove_handle(dispatcher->multi, transfer->handle);
+			g_ptr_array_remove_index_fast(dispatcher->transfers, i);
+			gemini_transfer_clear(transfer);
+			g_queue_push_head(&dispatcher->idle_transfers, transfer);
+		}
+	}
+	for (link = dispatcher->retries.head; link; link = next) {
+		next = link->next;
+		transfer = link->data;
+		if (was_removed(dispatcher, transfer)) {
+			g_queue_delete_link(&dispatcher->retries, link);
+			gemini_transfer_clear(transfer);
+			g_queue_push_head(&dispatcher->idle_transfers, transfer);
+		}
+	}
+	g_ptr_array_set_size(dispatcher->removed, 0);
+	g_cond_broadcast(&dispatcher->cond);
 }
 
-// --- Worker Thread Function ---
+// Runs every request concurrently on one multi handle. Elements keep at most
+// max-inflight requests in flight each, the dispatcher starts them as soon
+// as its limits allow and sleeps on the sockets in between.
 static gpointer
-gemini_worker_thread_func (gpointer data) {
-    GstGeminiVision *self = GST_GEMINI_VISION (data);
-    GeminiRequestData *req_data;
-    CURL *curl_handle;
-    CURLcode res;
-    struct curl_slist *headers = NULL;
-
-    GST_DEBUG_OBJECT (self, "Worker thread started.");
-
-    curl_global_init(CURL_GLOBAL_ALL); // Init curl for this thread
-
-    while (self->worker_running) {
-        // Block and wait for a request from the queue
-        req_data = g_async_queue_pop (self->request_queue);
-
-        if (!self->worker_running) { // Check again after pop, in case of shutdown
-             if (req_data) { // Free any pending request on shutdown
-                g_free(req_data->image_data);
-                g_free(req_data->api_key);
-                g_free(req_data->prompt);
-                g_free(req_data->model_name);
-                if (req_data->stop_sequences) g_strfreev(req_data->stop_sequences); // Free new prop
-                if (req_data->original_buffer) gst_buffer_unref(req_data->original_buffer);
-                g_free(req_data);
-            }
-            break;
-        }
+gemini_dispatcher_thread_func (gpointer data) {
+	GeminiDispatcher *dispatcher = data;
+	GeminiTransfer *transfer;
+	GeminiRequestData *req;
+	CURLMsg *msg;
+	int running, n_msgs;
+	guint finished;
+	gint64 now, wake_at;
 
-        if (!req_data->image_data && !req_data->prompt){
-			if (req_data->original_buffer) gst_buffer_unref(req_data->original_buffer); // Should be NULL for dummy
-			g_free(req_data->api_key); // Potentially NULL
-			g_free(req_data->prompt);  // Potentially NULL
-			g_free(req_data->model_name); // Potentially NULL
-			if (req_data->stop_sequences) g_strfreev(req_data->stop_sequences); // Potentially NULL
-			g_free(req_data);
-			continue;
-        }
+	GST_DEBUG("Dispatcher thread started.");
 
-        if (!req_data) { // Should not happen if worker_running is true
-            GST_WARNING_OBJECT(self, "Popped NULL request data unexpectedly.");
-            continue;
-        }
+	g_mutex_lock(&dispatcher->lock);
+	while (dispatcher->running) {
+		drop_removed_clients(dispatcher);
 
-        GST_DEBUG_OBJECT (
-			self, 
-			"Worker processing request for buffer PTS %" GST_TIME_FORMAT,
-            GST_TIME_ARGS(
-				req_data->original_buffer ? 
-				GST_BUFFER_PTS(req_data->original_buffer) : GST_CLOCK_TIME_NONE
-			)
-		);
+		// Retries are older than anything pending, they go first. While the
+		// API asks to back off no new request starts.
+		now = g_get_monotonic_time();
+		wake_at = now + G_TIME_SPAN_SECOND;
+		while ((transfer = g_queue_peek_head(&dispatcher->retries)) && transfer->retry_at <= now && 
+			may_start_transfer(dispatcher, now, &wake_at)) {
+			g_queue_pop_head(&dispatcher->retries);
+			restart_transfer(dispatcher, transfer);
+			g_array_append_val(dispatcher->request_times, now);
+		}
+		if (transfer && transfer->retry_at > now) {
+			wake_at = MIN(wake_at, transfer->retry_at);
+		}
+		if (now < dispatcher->backoff_until) {
+			wake_at = MIN(wake_at, dispatcher->backoff_until);
+		} else {
+			while (may_start_transfer(dispatcher, now, &wake_at) && (req = next_request(dispatcher))) {
+				if (start_transfer(dispatcher, req)) {
+					g_array_append_val(dispatcher->request_times, now);
+				}
+			}
+		}
+		g_mutex_unlock(&dispatcher->lock);
+
+		finished = 0;
+		curl_multi_perform(dispatcher->multi, &running);
+		while ((msg = curl_multi_info_read(dispatcher->multi, &n_msgs))) {
+			if (msg->msg == CURLMSG_DONE) {
+				finish_transfer(dispatcher, msg->easy_handle, msg->data.result);
+				finished++;
+			}
+		}
 
-        curl_handle = curl_easy_init();
-        if (curl_handle) {
-            MemoryStruct chunk;
-            chunk.data = g_malloc(1); // Will be grown by realloc
-            chunk.size = 0;
-
-            // 1. Base64 encode image_data
-            gchar *b64_image_data = g_base64_encode(req_data->image_data, req_data->image_size);
-            if (!b64_image_data) {
-                GST_ERROR_OBJECT(self, "Failed to Base64 encode image data.");
-                goto next_request; // Cleanup and get next item
-            }
-
-            // Construct JSON payload correctly matching the API format
-            json_object *jobj = json_object_new_object();
-            json_object *jcontents_array = json_object_new_array();
-            json_object *jcontent_obj = json_object_new_object();
-            json_object *jparts_array = json_object_new_array();
-
-            // First part: image (NOTE: order matters for Gemini)
-            json_object *jimage_part = json_object_new_object();
-            json_object *jinline_data = json_object_new_object();
-            json_object_object_add(jinline_data, "mime_type", json_object_new_string("image/jpeg"));
-            json_object_object_add(jinline_data, "data", json_object_new_string(b64_image_data));
-            json_object_object_add(jimage_part, "inline_data", jinline_data);
-            json_object_array_add(jparts_array, jimage_part);
-
-            // Second part: text prompt
-            json_object *jtext_part = json_object_new_object();
-            json_object_object_add(jtext_part, "text", json_object_new_string(req_data->prompt));
-            json_object_array_add(jparts_array, jtext_part);
-
-            // Complete the JSON structure
-            json_object_object_add(jcontent_obj, "parts", jparts_array);
-            json_object_array_add(jcontents_array, jcontent_obj);
-            json_object_object_add(jobj, "contents", jcontents_array);
-
-
-            // --- Add generationConfig ---
-            json_object *jgen_config = json_object_new_object();
-            gboolean gen_config_added = FALSE;
-
-            if (req_data->stop_sequences && req_data->stop_sequences[0] != NULL) {
-                json_object *jstop_seq_array = json_object_new_array();
-                for (int i = 0; req_data->stop_sequences[i] != NULL; i++) {
-                    json_object_array_add(jstop_seq_array, json_object_new_string(req_data->stop_sequences[i]));
-                }
-                json_object_object_add(jgen_config, "stopSequences", jstop_seq_array);
-                gen_config_added = TRUE;
-            }
-            if (req_data->temperature >= 0.0) { // Assuming -1.0 is "not set"
-                json_object_object_add(jgen_config, "temperature", json_object_new_double(req_data->temperature));
-                gen_config_added = TRUE;
-            }
-            if (req_data->max_output_tokens > 0) { // Assuming 0 or -1 is "not set"
-                json_object_object_add(jgen_config, "maxOutputTokens", json_object_new_int(req_data->max_output_tokens));
-                gen_config_added = TRUE;
-            }
-            if (req_data->top_p >= 0.0) { // Assuming -1.0 is "not set"
-                json_object_object_add(jgen_config, "topP", json_object_new_double(req_data->top_p));
-                gen_config_added = TRUE;
-            }
-            if (req_data->top_k > 0) { // Assuming 0 or -1 is "not set"
-                json_object_object_add(jgen_config, "topK", json_object_new_int(req_data->top_k));
-                gen_config_added = TRUE;
-            }
-
-            if (gen_config_added) {
-                json_object_object_add(jobj, "generationConfig", jgen_config);
-            } else {
-                json_object_put(jgen_config); // Not used, free it
-            }
-            // --- End generationConfig ---
-
-            const char *json_string = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_PLAIN);
-            GST_DEBUG_OBJECT(self, "Sending JSON: %s", json_string);
-
-            // Set up CURL
-            char *api_url = g_strdup_printf(
-				"https://generativelanguage.googleapis.com/v1beta/models/%s:generateContent?key=%s", 
-				req_data->model_name, req_data->api_key
+		// push_request() and removing an element interrupt the wait, and it
+		// ends early when a retry is due or a finished transfer freed a slot
+		if (finished == 0) {
+			now = g_get_monotonic_time();
+			curl_multi_poll(
+				dispatcher->multi, 
+				NULL, 
+				0, 
+				(int) CLAMP((wake_at - now + G_TIME_SPAN_MILLISECOND - 1) / G_TIME_SPAN_MILLISECOND, 0, 1000), 
+				NULL
 			);
-            curl_easy_setopt(curl_handle, CURLOPT_URL, api_url);
-            g_free(api_url); // Free the URL string
-            curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, json_string);
-            curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, (long)strlen(json_string));
-
-            headers = curl_slist_append(headers, "Content-Type: application/json");
-            curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-
-            curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-            curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
-
-            res = curl_easy_perform(curl_handle);
-
-            if (res != CURLE_OK) {
-                GST_ERROR_OBJECT(self, "curl_easy_perform() failed: %s", curl_easy_strerror(res));
-            } else {
-                GST_DEBUG_OBJECT(self, "%lu bytes retrieved from API", (unsigned long)chunk.size);
-                GST_DEBUG_OBJECT(self, "API Response: %s", chunk.data);
-
-                // Parse JSON response
-                json_object *parsed_json = json_tokener_parse(chunk.data);
-                json_object *candidates_array, *candidate, *content, *parts_array, *part, *text_obj;
-                const char *description_text = "No description found.";
-
-                if (parsed_json &&
-                    json_object_object_get_ex(parsed_json, "candidates", &candidates_array) &&
-                    json_object_is_type(candidates_array, json_type_array) &&
-                    json_object_array_length(candidates_array) > 0) {
-
-                    candidate = json_object_array_get_idx(candidates_array, 0);
-                    if (json_object_object_get_ex(candidate, "content", &content) &&
-                        json_object_object_get_ex(content, "parts", &parts_array) &&
-                        json_object_is_type(parts_array, json_type_array) &&
-                        json_object_array_length(parts_array) > 0) {
-
-                        part = json_object_array_get_idx(parts_array, 0); // Assuming first part is text
-                        if (json_object_object_get_ex(part, "text", &text_obj)) {
-                            description_text = json_object_get_string(text_obj);
-                        }
-                    }
-                } else if (parsed_json && json_object_object_get_ex(parsed_json, "error", &text_obj)) {
-                    // Handle API error responses
-                     json_object *message_obj;
-                     if(json_object_object_get_ex(text_obj, "message", &message_obj)){
-                        description_text = json_object_get_string(message_obj);
-                        GST_WARNING_OBJECT(self, "Gemini API Error: %s", description_text);
-                     } else {
-                        GST_WARNING_OBJECT(self, "Gemini API returned an error structure: %s", json_object_to_json_string(text_obj));
-                     }
-                } else {
-                    GST_WARNING_OBJECT(self, "Could not parse Gemini response or find text: %s", chunk.data);
-                }
-
-                // Send result (description_text and original_buffer) back to GStreamer thread
-                // For simplicity, we use another GAsyncQueue for results here.
-                GeminiResultData *result_data = g_new0(GeminiResultData, 1);
-                result_data->description = g_strdup(description_text);
-                result_data->original_buffer = req_data->original_buffer; // Transfer ownership
-                req_data->original_buffer = NULL; // Avoid double unref in cleanup
-                // Make sure the GstGeminiVision self pointer is also in result_data if needed by the callback
-                result_data->processor_element = req_data->self;
-
-                g_async_queue_push(self->result_queue, result_data);
-                // Trigger the GSource in the main GStreamer context to process results
-                if(self->result_source) {
-					g_source_set_ready_time(self->result_source, 0); // Wake it up if it's an idle source
-                }
-
-                if(parsed_json) json_object_put(parsed_json); // Free json-c object
-            }
-
-            // Cleanup for this request
-            curl_slist_free_all(headers);
-            headers = NULL;
-            curl_easy_cleanup(curl_handle);
-            g_free(b64_image_data);
-            json_object_put(jobj); // Free our request json-c object
-            g_free(chunk.data);
-        }
+		}
+		g_mutex_lock(&dispatcher->lock);
+	}
+	g_mutex_unlock(&dispatcher->lock);
+
+	// Only the transfers of the last element can be left, it stopped
+	for (guint i = 0; i < dispatcher->transfers->len; i++) {
+		transfer = g_ptr_array_index(dispatcher->transfers, i);
+		curl_multi_remove_handle(dispatcher->multi, transfer->handle);
+		gemini_transfer_free(transfer);
+	}
+	g_ptr_array_set_size(dispatcher->transfers, 0);
+	while ((transfer = g_queue_pop_head(&dispatcher->retries))) {
+		gemini_transfer_free(transfer);
+	}
+	while ((transfer = g_queue_pop_head(&dispatcher->idle_transfers))) {
+		gemini_transfer_free(transfer);
+	}
+
+	GST_DEBUG("Dispatcher thread finished.");
+	return NULL;
+}
+
+static GeminiDispatcher *
+gemini_dispatcher_new(const gchar *thread_name) {
+	GeminiDispatcher *dispatcher = g_new0(GeminiDispatcher, 1);
+
+	dispatcher->multi = curl_multi_init();
+	// Concurrent requests become streams of one HTTP/2 connection
+	curl_multi_setopt(dispatcher->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	g_mutex_init(&dispatcher->lock);
+	g_cond_init(&dispatcher->cond);
+	dispatcher->running = TRUE;
+	dispatcher->clients = g_ptr_array_new();
+	dispatcher->removed = g_ptr_array_new();
+	dispatcher->transfers = g_ptr_array_new();
+	g_queue_init(&dispatcher->idle_transfers);
+	g_queue_init(&dispatcher->retries);
+	dispatcher->request_times = g_array_new(FALSE, FALSE, sizeof(gint64));
+	dispatcher->thread = g_thread_new(thread_name, gemini_dispatcher_thread_func, dispatcher);
+	return dispatcher;
+}
+
+// Ends the thread, dropping whatever is still in flight
+static void
+gemini_dispatcher_free(GeminiDispatcher *dispatcher) {
+	g_mutex_lock(&dispatcher->lock);
+	dispatcher->running = FALSE;
+	g_mutex_unlock(&dispatcher->lock);
+	curl_multi_wakeup(dispatcher->multi);
+	g_thread_join(dispatcher->thread);
+
+	curl_multi_cleanup(dispatcher->multi);
+	g_mutex_clear(&dispatcher->lock);
+	g_cond_clear(&dispatcher->cond);
+	g_ptr_array_free(dispatcher->clients, TRUE);
+	g_ptr_array_free(dispatcher->removed, TRUE);
+	g_ptr_array_free(dispatcher->transfers, TRUE);
+	g_array_free(dispatcher->request_times, TRUE);
+	g_free(dispatcher);
+}
+
+// The strictest limit any element asks for applies, called with the lock
+// held
+static void
+update_limits(GeminiDispatcher *dispatcher) {
+	dispatcher->max_rpm = 0;
+	dispatcher->max_transfers = 0;
+	for (guint i = 0; i < dispatcher->clients->len; i++) {
+		GeminiClient *client = g_ptr_array_index(dispatcher->clients, i);
+
+		if (client->max_rpm > 0 && (dispatcher->max_rpm == 0 || client->max_rpm < dispatcher->max_rpm)) {
+			dispatcher->max_rpm = client->max_rpm;
+		}
+		if (client->max_transfers > 0 && (dispatcher->max_transfers == 0 || client->max_transfers < dispatcher->max_transfers)) {
+			dispatcher->max_transfers = client->max_transfers;
+		}
+	}
+}
+
+// Starts sending the element's requests, on a dispatcher of its own or the
+// one shared by the process, which is created by the first element using it
+static void
+acquire_dispatcher(GstGeminiVision *self) {
+	GeminiClient *client = g_new0(GeminiClient, 1);
+	GeminiDispatcher *dispatcher;
+
+	client->self = self;
+	g_queue_init(&client->pending);
+	client->priority = self->priority;
+	client->max_rpm = self->max_rpm;
+
+	if (self->shared_dispatcher) {
+		client->max_transfers = self->shared_max_transfers;
+		g_mutex_lock(&shared_dispatcher_lock);
+		if (!shared_dispatcher) {
+			shared_dispatcher = gemini_dispatcher_new("gemini-dispatcher");
+			GST_INFO_OBJECT(self, "Shared dispatcher created.");
+		}
+		shared_dispatcher->users++;
+		dispatcher = shared_dispatcher;
+		g_mutex_unlock(&shared_dispatcher_lock);
+	} else {
+		// max-inflight is all the limit a single element needs
+		gchar *thread_name = g_strdup_printf("%s-worker", GST_OBJECT_NAME(self));
+		dispatcher = gemini_dispatcher_new(thread_name);
+		g_free(thread_name);
+		GST_INFO_OBJECT(self, "Worker thread created.");
+	}
+
+	g_mutex_lock(&dispatcher->lock);
+	g_ptr_array_add(dispatcher->clients, client);
+	update_limits(dispatcher);
+	g_mutex_unlock(&dispatcher->lock);
+	self->dispatcher = dispatcher;
+}
+
+// Stops sending the element's requests. Those not sent yet are freed here,
+// the ones in flight by the dispatcher thread, which is waited for, so the
+// element is no longer referenced once this returns.
+static void
+release_dispatcher(GstGeminiVision *self) {
+	GeminiDispatcher *dispatcher = self->dispatcher;
+	GeminiClient *client;
+	GeminiRequestData *req;
+	gboolean last = TRUE;
+
+	if (!dispatcher) {
+		return;
+	}
+
+	g_mutex_lock(&dispatcher->lock);
+	client = find_client(dispatcher, self);
+	g_ptr_array_remove(dispatcher->clients, client);
+	update_limits(dispatcher);
+	g_ptr_array_add(dispatcher->removed, self);
+	curl_multi_wakeup(dispatcher->multi);
+	while (dispatcher->running && g_ptr_array_find(dispatcher->removed, self, NULL)) {
+		g_cond_wait(&dispatcher->cond, &dispatcher->lock);
+	}
+	g_mutex_unlock(&dispatcher->lock);
+
+	while ((req = g_queue_pop_head(&client->pending))) {
+		gemini_request_data_free(req);
+	}
+	g_free(client);
+
+	g_mutex_lock(&shared_dispatcher_lock);
+	if (dispatcher == shared_dispatcher) {
+		last = --dispatcher->users == 0;
+		if (last) {
+			shared_dispatcher = NULL;
+		}
+	}
+	g_mutex_unlock(&shared_dispatcher_lock);
+	if (last) {
+		gemini_dispatcher_free(dispatcher);
+	}
+	self->dispatcher = NULL;
+}
+
+static void
+clear_pending_batch(GstGeminiVision *self) {
+	for (guint i = 0; i < self->pending_batch->len; i++) {
+		gemini_request_data_free(g_ptr_array_index(self->pending_batch, i));
+	}
+	g_ptr_array_set_size(self->pending_batch, 0);
+}
 
-    next_request:
-		g_free(req_data->image_data);
-		g_free(req_data->api_key);
-		g_free(req_data->prompt);
-		g_free(req_data->model_name);
-		if (req_data->stop_sequences) g_strfreev(req_data->stop_sequences);
-		if (req_data->original_buffer) gst_buffer_unref(req_data->original_buffer);
-		g_free(req_data);
-    }
+// Frees the requests the encoder thread has not taken, which would otherwise
+// be sent by the next run with sequence numbers of this one
+static void
+drain_encode_queue(GstGeminiVision *self) {
+	GeminiRequestData *req;
+
+	while ((req = g_async_queue_try_pop(self->encode_queue))) {
+		gemini_request_data_free(req);
+	}
+}
 
-    curl_global_cleanup(); // Cleanup curl for this thread
-    GST_DEBUG_OBJECT (self, "Worker thread finished.");
-    return NULL;
+// Ends the encoder thread and the element's part in its dispatcher. Requests
+// still being collected, encoded, queued or in flight are dropped.
+static void
+stop_processing(GstGeminiVision *self) {
+	clear_pending_batch(self);
+	self->worker_running = FALSE;
+	g_async_queue_push(self->encode_queue, g_new0(GeminiRequestData, 1));
+	// The encoder thread is the one submitting requests
+	if (self->encoder_thread) {
+		g_thread_join(self->encoder_thread);
+		self->encoder_thread = NULL;
+	}
+	drain_encode_queue(self);
+	release_dispatcher(self);
+	delete_prompt_cache(self);
 }
 
 // Called when the object is about to be destroyed.
@@ -618,42 +2889,24 @@ static void
 gst_gemini_vision_dispose(GObject *object) {
   	GstGeminiVision *self = GST_GEMINI_VISION(object);
   
+	// Normally done in stop. The encoder thread must be gone before its
+	// encoder state is freed below.
 	if (self->worker_running) {
-		self->worker_running = FALSE;
-		if (self->request_queue) {
-			GeminiRequestData *dummy_req = g_new0(GeminiRequestData, 1);
-			// Set dummy values for fields that might be checked if it's not a simple NULL check
-			dummy_req->image_data = NULL; 
-			dummy_req->prompt = NULL; 
-			g_async_queue_push(self->request_queue, dummy_req);
-		}
-		if (self->worker_thread) {
-			g_thread_join(self->worker_thread);
-			self->worker_thread = NULL;
-		}
+		stop_processing(self);
 	}
-  
-	if (self->request_queue) {
-		GeminiRequestData *req;
-		while ((req = g_async_queue_try_pop(self->request_queue))) {
-			g_free(req->image_data);
-			g_free(req->api_key);
-			g_free(req->prompt);
-			g_free(req->model_name);
-			if (req->stop_sequences) g_strfreev(req->stop_sequences);
-			if (req->original_buffer) gst_buffer_unref(req->original_buffer);
-			g_free(req);
-		}
-		g_async_queue_unref(self->request_queue);
-		self->request_queue = NULL;
+	gst_gemini_record_close(self->record);
+	self->record = NULL;
+
+	if (self->encode_queue) {
+		drain_encode_queue(self);
+		g_async_queue_unref(self->encode_queue);
+		self->encode_queue = NULL;
 	}
   
 	if (self->result_queue) {
 		GeminiResultData *res;
 		while ((res = g_async_queue_try_pop(self->result_queue))) {
-			g_free(res->description);
-			if (res->original_buffer) gst_buffer_unref(res->original_buffer);
-			g_free(res);
+			gemini_result_data_free(res);
 		}
 		g_async_queue_unref(self->result_queue);
 		self->result_queue = NULL;
@@ -665,6 +2918,8 @@ gst_gemini_vision_dispose(GObject *object) {
 		self->result_source = NULL;
 	}
   
+	g_free(self->api_endpoint);
+	self->api_endpoint = NULL;
 	g_free(self->api_key);
 	self->api_key = NULL;
 	g_free(self->prompt);
@@ -678,27 +2933,100 @@ gst_gemini_vision_dispose(GObject *object) {
 
 	g_free(self->pending_description);
 	self->pending_description = NULL;
+	g_free(self->settings_digest);
+	self->settings_digest = NULL;
+	g_free(self->record_file);
+	self->record_file = NULL;
+	g_hash_table_remove_all(self->roi_descriptions);
+	g_hash_table_remove_all(self->held_results);
+
+	clear_scaling(self);
+	gst_gemini_jpeg_encoder_clear(&self->jpeg_encoder);
+	clear_stripe_encoders(self);
 	
 	G_OBJECT_CLASS(gst_gemini_vision_parent_class)->dispose(object);
 }
 
-// --- Update result callback to apply to current buffer ---
-static gboolean
-process_gemini_result_callback (gpointer data){
-	GstGeminiVision *self = GST_GEMINI_VISION (data);
-	GeminiResultData *result;
-  
-	// Process all available results
-	while ((result = g_async_queue_try_pop(self->result_queue))) {
-		GST_INFO_OBJECT(self, "Received description: %s", result->description);
-		
+static void
+gst_gemini_vision_finalize(GObject *object) {
+	GstGeminiVision *self = GST_GEMINI_VISION(object);
+
+	g_mutex_clear(&self->stripe_lock);
+	g_cond_clear(&self->stripe_cond);
+	g_hash_table_unref(self->roi_descriptions);
+	g_hash_table_unref(self->held_results);
+	g_ptr_array_free(self->pending_batch, TRUE);
+
+	GeminiCacheEntry *entry;
+	while ((entry = g_queue_pop_head(&self->description_cache))) {
+		gemini_cache_entry_free(entry);
+	}
+	g_mutex_clear(&self->description_cache_lock);
+
+	G_OBJECT_CLASS(gst_gemini_vision_parent_class)->finalize(object);
+}
+
+// Hands one description to the application, as metadata for the next
+// buffers or through the signals
+static void
+deliver_description(GstGeminiVision *self, GeminiResultData *result) {
+	if (result->description && deadline_passed(result->deadline)) {
+		// Held back too long behind an older request, or the main loop was busy
+		GST_DEBUG_OBJECT(self, "Dropping a description older than max-result-age");
+		return;
+	}
+	if (result->partial) {
+		// Streamed text so far, the complete description follows
+		if (self->output_metadata) {
+			g_free(self->pending_description);
+			self->pending_description = g_strdup(result->description);
+		} else if (result->original_buffer) {
+			g_signal_emit(
+				self, 
+				g_signal_lookup("description-partial", GST_TYPE_GEMINI_VISION), 
+				0,
+				result->description, 
+				result->original_buffer
+			);
+		}
+		return;
+	}
+	if (!result->description) {
+		// The request failed, it was logged where it happened
+		return;
+	}
+	GST_INFO_OBJECT(self, "Received description: %s", result->description);
+
+	if (result->has_roi) {
+		// Only the regions of the latest analysis are kept
+		GST_OBJECT_LOCK(self);
+		if (result->analysis_id != self->roi_descriptions_analysis) {
+			g_hash_table_remove_all(self->roi_descriptions);
+			self->roi_descriptions_analysis = result->analysis_id;
+		}
+		g_hash_table_replace(
+			self->roi_descriptions, 
+			GINT_TO_POINTER(result->roi_id), 
+			g_strdup(result->description)
+		);
+		GST_OBJECT_UNLOCK(self);
+
+		if (!self->output_metadata && result->original_buffer) {
+			g_signal_emit(
+				self, 
+				g_signal_lookup("roi-description-received", GST_TYPE_GEMINI_VISION), 
+				0,
+				result->description, 
+				result->original_buffer,
+				result->roi_id,
+				g_quark_to_string(result->roi_type)
+			);
+		}
+	} else {
 		// Store the result for the next buffer
 		g_free(self->pending_description);
 		self->pending_description = g_strdup(result->description);
 		
-		// Mark that we're done with this analysis and can start another
-		self->analysis_in_progress = FALSE;
-		
 		// Emit signal (if configured)
 		if (!self->output_metadata) {
 			// Fix: Don't try to pass NULL as a buffer - either use result->original_buffer 
@@ -715,29 +3043,144 @@ process_gemini_result_callback (gpointer data){
 				GST_WARNING_OBJECT(self, "No buffer available for signal emission");
 			}
 		}
-		
-		// Clean up
-		g_free(result->description);
-		if (result->original_buffer) gst_buffer_unref(result->original_buffer);
-		g_free(result);
+	}
+}
+
+// Delivers a result, and the frames of a batch one after the other with
+// their own buffers
+static void
+deliver_result(GstGeminiVision *self, GeminiResultData *result) {
+	deliver_description(self, result);
+	for (guint i = 0; result->batch && i < result->batch->len; i++) {
+		deliver_description(self, g_ptr_array_index(result->batch, i));
+	}
+}
+
+// --- Update result callback to apply to current buffer ---
+static gboolean
+process_gemini_result_callback (gpointer data){
+	GstGeminiVision *self = GST_GEMINI_VISION (data);
+	GeminiResultData *result;
+  
+	// Process all available results
+	while ((result = g_async_queue_try_pop(self->result_queue))) {
+		if (result->partial) {
+			// When ordered, only the oldest request may show its progress,
+			// text from a later one would overtake a description to come
+			if (!self->ordered_results || result->seq == self->delivery_seq) {
+				deliver_result(self, result);
+			}
+			gemini_result_data_free(result);
+			continue;
+		}
+
+		// The slot is free as soon as the answer is here, even if an older
+		// request still holds its delivery back
+		g_atomic_int_add(&self->requests_in_flight, -1);
+
+		if (!self->ordered_results) {
+			deliver_result(self, result);
+			gemini_result_data_free(result);
+			continue;
+		}
+
+		// Requests are numbered in PTS order. A result that overtook an
+		// older one waits until everything before it has been delivered.
+		g_hash_table_insert(self->held_results, GUINT_TO_POINTER(result->seq), result);
+		while ((result = g_hash_table_lookup(self->held_results, GUINT_TO_POINTER(self->delivery_seq)))) {
+			deliver_result(self, result);
+			g_hash_table_remove(self->held_results, GUINT_TO_POINTER(self->delivery_seq));
+			self->delivery_seq++;
+		}
 	}
 		
 	return G_SOURCE_CONTINUE;
 }
 
 
+// Has the dispatcher open the connection to the API before the first frame
+static void
+prewarm_connection(GstGeminiVision *self) {
+	GeminiRequestData *req = g_new0(GeminiRequestData, 1);
+
+	req->prewarm = TRUE;
+	req->self = self;
+	req->api_endpoint = g_strdup(self->api_endpoint);
+	req->api_key = g_strdup(self->api_key);
+	req->model_name = g_strdup(self->model_name);
+	g_async_queue_push(self->encode_queue, req);
+}
+
+// Has the encoder thread encode a blank frame of the negotiated caps
+static void
+prewarm_encoder(GstGeminiVision *self) {
+	GeminiRequestData *req = g_new0(GeminiRequestData, 1);
+	gsize size = GST_VIDEO_INFO_SIZE(&self->input_video_info);
+
+	req->prewarm = TRUE;
+	req->self = self;
+	req->video_info = self->input_video_info;
+	req->original_buffer = gst_buffer_new_wrapped(g_malloc0(size), size);
+	g_async_queue_push(self->encode_queue, req);
+}
+
 static gboolean
 gst_gemini_vision_start (GstBaseTransform * trans) {
 	GstGeminiVision *self = GST_GEMINI_VISION (trans);
 	GST_INFO_OBJECT (self, "Starting");
 	self->last_analysis_time_ns = 0;
+	self->backoff_until = 0;
+	self->has_scene_reference = FALSE;
+	self->http_version = 0;
+	self->max_streams = 0;
+	g_free(self->settings_digest);
+	self->settings_digest = digest_settings(self);
+
+	if (self->record_file && self->record_file[0] != '\0') {
+		GError *error = NULL;
+
+		self->record = gst_gemini_record_open(
+			self->record_file, 
+			self->record_mode != GST_GEMINI_RECORD_MODE_REPLAY, 
+			&error
+		);
+		if (!self->record) {
+			GST_ELEMENT_ERROR(self, RESOURCE, OPEN_READ_WRITE, ("Failed to open record-file"), ("%s", error->message));
+			g_error_free(error);
+			return FALSE;
+		}
+	}
+
+	// Results of the previous run would be numbered like the new requests
+	GeminiResultData *stale;
+	while ((stale = g_async_queue_try_pop(self->result_queue))) {
+		gemini_result_data_free(stale);
+	}
+	g_hash_table_remove_all(self->held_results);
+	drain_encode_queue(self);
+	// Scaling and quality depend on properties that may have changed in
+	// READY, the first frame sets them up again even if the caps did not
+	// change. The encoder thread is not running yet.
+	gst_video_info_init(&self->encode_video_info);
+	self->requests_in_flight = 0;
+	self->request_seq = 0;
+	self->delivery_seq = 0;
 	self->worker_running = TRUE;
 
-	if (!self->worker_thread) {
-		gchar *thread_name = g_strdup_printf("%s-worker", GST_OBJECT_NAME(self));
-		self->worker_thread = g_thread_new (thread_name, gemini_worker_thread_func, self);
+	// The encoder thread hands its requests to the dispatcher, and the
+	// record file is read from the first request on
+	if (!self->dispatcher) {
+		acquire_dispatcher(self);
+	}
+	if (!self->encoder_thread) {
+		gchar *thread_name = g_strdup_printf("%s-encoder", GST_OBJECT_NAME(self));
+		self->encoder_thread = g_thread_new (thread_name, gemini_encoder_thread_func, self);
 		g_free(thread_name);
-		GST_INFO_OBJECT (self, "Worker thread created.");
+		GST_INFO_OBJECT (self, "Encoder thread created.");
+	}
+	if (self->prewarm && self->api_key && self->api_key[0] != '\0' && !replay_only(self)) {
+		// DNS, TCP, TLS and HTTP/2 are set up while the pipeline prerolls
+		prewarm_connection(self);
 	}
 
 	// Create and attach GSource for results
@@ -756,25 +3199,21 @@ gst_gemini_vision_stop (GstBaseTransform * trans) {
 	GstGeminiVision *self = GST_GEMINI_VISION (trans);
 	GST_INFO_OBJECT (self, "Stopping");
 
-	// Worker thread is stopped in dispose, which is called after stop
-	// But you might want to signal it earlier or clear queues here
+	// Requests in flight are aborted rather than waited for. Nothing
+	// touches the result source once the dispatcher has let go.
 	if (self->worker_running) {
-		self->worker_running = FALSE;
-		// Push a NULL to potentially unblock the worker from g_async_queue_pop
-		// The worker thread checks self->worker_running after popping.
-		if(self->request_queue) {
-			GeminiRequestData *dummy_req = g_new0(GeminiRequestData, 1);
-			g_async_queue_push(self->request_queue, dummy_req);
-			// Don't join here, join in dispose. GStreamer handles object lifecycle.
-		}
+		stop_processing(self);
 		if (self->result_source) { // Detach and destroy source on stop
 			g_source_destroy(self->result_source);
 			g_source_unref(self->result_source);
 			self->result_source = NULL;
 		}
-
-		return TRUE;
 	}
+	// Only closed once the dispatcher can no longer record into it
+	gst_gemini_record_close(self->record);
+	self->record = NULL;
+
+	return TRUE;
 }
 
 static gboolean
@@ -797,6 +3236,12 @@ gst_gemini_vision_set_caps (
   
 	if (g_str_equal(name, "image/jpeg")) {
 		self->input_is_jpeg = TRUE;
+		if (self->roi_analysis) {
+			GST_WARNING_OBJECT(self, "Regions cannot be cropped from JPEG input, analyzing whole frames");
+		}
+		if (self->scene_threshold > 0.0) {
+			GST_WARNING_OBJECT(self, "Scene changes are not detected in JPEG input, analyzing at every analysis-interval");
+		}
 	} else {
 		self->input_is_jpeg = FALSE;
 		// Parse video info for raw video
@@ -804,18 +3249,241 @@ gst_gemini_vision_set_caps (
 			GST_ERROR_OBJECT(self, "Failed to parse video info from caps");
 			return FALSE;
 		}
+
+		// Reject what the encoder cannot handle now rather than on the first
+		// analyzed frame. The encoder thread sets up its own converter.
+		GstGeminiRowConverter conv;
+		GstVideoFormat format = GST_VIDEO_INFO_FORMAT(&self->input_video_info);
+		if (!gst_gemini_row_converter_init(&conv, format)) {
+			GST_ERROR_OBJECT(
+				self, 
+				"Unsupported video format for JPEG encoding: %s", 
+				gst_video_format_to_string(format)
+			);
+			return FALSE;
+		}
+		if (self->prewarm && self->worker_running) {
+			prewarm_encoder(self);
+		}
 	}
 	
 	return TRUE;
 }
 
 // --- Modify transform_ip to add pending description to each buffer ---
+// Request for buf carrying the current properties, the region is set by the
+// caller when regions are analyzed on their own
+static GeminiRequestData *
+gemini_request_data_new(GstGeminiVision *self, GstBuffer *buf) {
+	GeminiRequestData *req = g_new0(GeminiRequestData, 1);
+
+	req->original_buffer = gst_buffer_ref(buf);
+	req->is_jpeg = self->input_is_jpeg;
+	if (!req->is_jpeg) {
+		req->video_info = self->input_video_info;
+	}
+	req->api_endpoint = g_strdup(self->api_endpoint);
+	req->api_key = g_strdup(self->api_key);
+	req->prompt = g_strdup(self->prompt);
+	req->model_name = g_strdup(self->model_name);
+	req->self = self;
+
+	// Copy generationConfig properties to request data
+	if (self->stop_sequences) {
+		req->stop_sequences = g_strdupv(self->stop_sequences);
+	} else {
+		req->stop_sequences = NULL;
+	}
+	req->temperature = self->temperature;
+	req->max_output_tokens = self->max_output_tokens;
+	req->top_p = self->top_p;
+	req->top_k = self->top_k;
+	req->stream = self->stream_responses;
+	req->max_retries = self->max_retries;
+	if (self->max_result_age_sec > 0) {
+		req->deadline = g_get_monotonic_time() + (gint64) (self->max_result_age_sec * G_TIME_SPAN_SECOND);
+	}
+	return req;
+}
+
+// Grows the region by roi-padding, clamps it to the frame and widens it to
+// whole chroma samples. Returns FALSE for regions outside the frame.
+static gboolean
+set_request_roi(GstGeminiVision *self, GeminiRequestData *req, const GstVideoRegionOfInterestMeta *roi) {
+	const gint64 width = GST_VIDEO_INFO_WIDTH(&req->video_info);
+	const gint64 height = GST_VIDEO_INFO_HEIGHT(&req->video_info);
+	gint64 x0 = (gint64) roi->x - self->roi_padding;
+	gint64 y0 = (gint64) roi->y - self->roi_padding;
+	gint64 x1 = (gint64) roi->x + roi->w + self->roi_padding;
+	gint64 y1 = (gint64) roi->y + roi->h + self->roi_padding;
+
+	x0 = CLAMP(x0, 0, width) & ~1;
+	y0 = CLAMP(y0, 0, height) & ~1;
+	x1 = MIN(GST_ROUND_UP_2(CLAMP(x1, 0, width)), width);
+	y1 = MIN(GST_ROUND_UP_2(CLAMP(y1, 0, height)), height);
+	if (x1 <= x0 || y1 <= y0) {
+		GST_DEBUG_OBJECT(self, "Skipping region %d outside the frame", roi->id);
+		return FALSE;
+	}
+
+	req->has_roi = TRUE;
+	req->roi_id = roi->id;
+	req->roi_type = roi->roi_type;
+	req->roi_x = (guint) x0;
+	req->roi_y = (guint) y0;
+	req->roi_width = (guint) (x1 - x0);
+	req->roi_height = (guint) (y1 - y0);
+	return TRUE;
+}
+
+// Adds the latest description of each region to the matching region meta of
+// buf, as a "GstGeminiDescription" parameter with a "description" field
+static void
+apply_roi_descriptions(GstGeminiVision *self, GstBuffer *buf) {
+	gpointer state = NULL;
+	GstMeta *meta;
+
+	if (!gst_buffer_is_writable(buf)) {
+		return;
+	}
+
+	GST_OBJECT_LOCK(self);
+	while ((meta = gst_buffer_iterate_meta_filtered(buf, &state, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+		GstVideoRegionOfInterestMeta *roi = (GstVideoRegionOfInterestMeta *) meta;
+		const gchar *description = g_hash_table_lookup(self->roi_descriptions, GINT_TO_POINTER(roi->id));
+
+		if (description && !gst_video_region_of_interest_meta_get_param(roi, "GstGeminiDescription")) {
+			gst_video_region_of_interest_meta_add_param(
+				roi, 
+				gst_structure_new("GstGeminiDescription", "description", G_TYPE_STRING, description, NULL)
+			);
+		}
+	}
+	GST_OBJECT_UNLOCK(self);
+}
+
+// Frames are mapped with gst_video_frame_map(), which honours the offsets and
+// strides of a GstVideoMeta. Saying so lets decoders and v4l2 sources hand
+// over padded buffers as they are instead of having them copied upstream.
+static gboolean
+gst_gemini_vision_propose_allocation (
+	GstBaseTransform * trans, 
+	GstQuery * decide_query,
+	GstQuery * query
+) {
+	GstCaps *caps;
+
+	if (!GST_BASE_TRANSFORM_CLASS(gst_gemini_vision_parent_class)->propose_allocation(trans, decide_query, query)) {
+		return FALSE;
+	}
+
+	gst_query_parse_allocation(query, &caps, NULL);
+	if (caps && gst_structure_has_name(gst_caps_get_structure(caps, 0), "video/x-raw") &&
+		!gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL)) {
+		gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+	}
+	return TRUE;
+}
+
+// TRUE while the API asked us to slow down, no new analysis is started then
+static gboolean
+backing_off(GstGeminiVision *self) {
+	gboolean backing_off;
+
+	GST_OBJECT_LOCK(self);
+	backing_off = self->backoff_until > g_get_monotonic_time();
+	GST_OBJECT_UNLOCK(self);
+	return backing_off;
+}
+
+// Numbers the requests of one analysis and hands them to the encoder thread
+static void
+queue_analysis(GstGeminiVision *self, GPtrArray *requests) {
+	self->analysis_id++;
+	g_atomic_int_add(&self->requests_in_flight, (gint) requests->len);
+
+	for (guint i = 0; i < requests->len; i++) {
+		GeminiRequestData *req = g_ptr_array_index(requests, i);
+		req->analysis_id = self->analysis_id;
+		req->seq = self->request_seq++;
+		g_async_queue_push(self->encode_queue, req);
+	}
+}
+
+// With scene-threshold set, TRUE only if buf differs enough from the last
+// analyzed frame or max-analysis-interval has passed since. Other frames
+// keep the last description. The thumbnail is kept for remember_scene().
+static gboolean
+scene_changed(GstGeminiVision *self, GstBuffer *buf, GstClockTime current_time) {
+	GstVideoFrame frame;
+	gdouble change;
+
+	self->has_scene_thumbnail = FALSE;
+	if (self->scene_threshold <= 0.0 || self->input_is_jpeg) {
+		return TRUE;
+	}
+	if (!gst_video_frame_map(&frame, &self->input_video_info, buf, GST_MAP_READ)) {
+		GST_WARNING_OBJECT(self, "Failed to map buffer for scene detection.");
+		return TRUE;
+	}
+	self->has_scene_thumbnail = gst_gemini_thumbnail(&frame, self->scene_thumbnail);
+	gst_video_frame_unmap(&frame);
+	if (!self->has_scene_thumbnail || !self->has_scene_reference) {
+		return TRUE;
+	}
+
+	change = gst_gemini_sad(self->scene_thumbnail, self->scene_reference, GST_GEMINI_THUMBNAIL_SIZE) / 
+		(255.0 * GST_GEMINI_THUMBNAIL_SIZE);
+	if (change >= self->scene_threshold) {
+		GST_DEBUG_OBJECT(self, "Scene changed by %.4f", change);
+		return TRUE;
+	}
+	if (self->max_analysis_interval > 0 && 
+		GST_CLOCK_TIME_IS_VALID(current_time) && 
+		GST_CLOCK_TIME_IS_VALID(self->last_analysis_time_ns) &&
+		current_time - self->last_analysis_time_ns >= self->max_analysis_interval) {
+		GST_DEBUG_OBJECT(self, "Scene changed by %.4f only, analyzing after max-analysis-interval", change);
+		return TRUE;
+	}
+	GST_LOG_OBJECT(self, "Scene changed by %.4f only, keeping the last description", change);
+	return FALSE;
+}
+
+// Makes the frame just queued the one later frames are compared to
+static void
+remember_scene(GstGeminiVision *self) {
+	if (self->has_scene_thumbnail) {
+		memcpy(self->scene_reference, self->scene_thumbnail, GST_GEMINI_THUMBNAIL_SIZE);
+		self->has_scene_reference = TRUE;
+		self->has_scene_thumbnail = FALSE;
+	}
+}
+
+// Turns the collected frames into one request, carried by the oldest frame.
+// The request is of use until the newest frame's deadline, each description
+// is still dropped past the deadline of its own frame.
+static GeminiRequestData *
+take_batch(GstGeminiVision *self) {
+	GeminiRequestData *req = g_ptr_array_index(self->pending_batch, 0);
+	GeminiRequestData *newest = g_ptr_array_index(self->pending_batch, self->pending_batch->len - 1);
+
+	req->frame_deadline = req->deadline;
+	req->deadline = newest->deadline;
+	req->batch = g_ptr_array_new_with_free_func((GDestroyNotify) gemini_request_data_free);
+	for (guint i = 1; i < self->pending_batch->len; i++) {
+		g_ptr_array_add(req->batch, g_ptr_array_index(self->pending_batch, i));
+	}
+	g_ptr_array_set_size(self->pending_batch, 0);
+	return req;
+}
+
 static GstFlowReturn
 gst_gemini_vision_transform_ip (GstBaseTransform * trans, GstBuffer * buf) {
 	GstGeminiVision *self = GST_GEMINI_VISION (trans);
 	GstClockTime current_time = GST_BUFFER_PTS(buf); // Or GST_BUFFER_DTS or calculate running time
   
-	if (!self->analysis_in_progress && 
+	if (g_atomic_int_get(&self->requests_in_flight) < self->max_inflight && 
+		!backing_off(self) &&
 		(self->last_analysis_time_ns == 0 || 
 		(
 			GST_CLOCK_TIME_IS_VALID(current_time) && 
@@ -824,7 +3492,8 @@ gst_gemini_vision_transform_ip (GstBaseTransform * trans, GstBuffer * buf) {
 		) ||
 		!GST_CLOCK_TIME_IS_VALID(current_time) || 
 		!GST_CLOCK_TIME_IS_VALID(self->last_analysis_time_ns) // Handle invalid timestamps by analyzing
-		)
+		) &&
+		scene_changed(self, buf, current_time)
 	) {
     
 		GST_INFO_OBJECT(
@@ -833,7 +3502,7 @@ gst_gemini_vision_transform_ip (GstBaseTransform * trans, GstBuffer * buf) {
 			GST_TIME_ARGS(current_time)
 		);
 		
-		if (!self->api_key || self->api_key[0] == '\0') {
+		if ((!self->api_key || self->api_key[0] == '\0') && !replay_only(self)) {
 			GST_WARNING_OBJECT(self, "API Key not set. Skipping analysis.");
 			// Still apply pending description if any
 			if (self->output_metadata && self->pending_description && gst_buffer_is_writable(buf)) {
@@ -842,7 +3511,7 @@ gst_gemini_vision_transform_ip (GstBaseTransform * trans, GstBuffer * buf) {
 			return GST_FLOW_OK;
 		}
 		
-		if (!self->worker_running || !self->worker_thread) {
+		if (!self->worker_running || !self->dispatcher || !self->encoder_thread) {
 			GST_WARNING_OBJECT(self, "Worker not running. Skipping analysis.");
 			if (self->output_metadata && self->pending_description && gst_buffer_is_writable(buf)) {
 				gst_buffer_add_gemini_description_meta(buf, self->pending_description);
@@ -850,63 +3519,50 @@ gst_gemini_vision_transform_ip (GstBaseTransform * trans, GstBuffer * buf) {
 			return GST_FLOW_OK;
 		}
 		
-		GstMapInfo map;
-		GST_INFO_OBJECT(self, "Mapping buffer for analysis.");
-		if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
-			GST_INFO_OBJECT(self, "Buffer mapped successfully.");
-			unsigned char *jpeg_data = NULL;
-			unsigned long jpeg_size = 0;
-		
-			if (!self->input_is_jpeg) {
-				GST_INFO_OBJECT(self, "Input is not jpg");
-				if (!encode_frame_to_jpeg(self, &map, &jpeg_data, &jpeg_size)) {
-					GST_ERROR_OBJECT(self, "Failed to encode frame to JPEG");
-					gst_buffer_unmap(buf, &map);
-					return GST_FLOW_ERROR; 
-				}
-			} else {
-				GST_INFO_OBJECT(self, "Input is jpg");
-				jpeg_data = g_malloc(map.size);
-				if (jpeg_data) { // Check malloc success
-					memcpy(jpeg_data, map.data, map.size);
-					jpeg_size = map.size;
+		// Only a reference is taken here, mapping and encoding happen on the
+		// encoder thread so the streaming thread never waits for pixel work
+		GPtrArray *requests = g_ptr_array_new();
+
+		if (self->roi_analysis && !self->input_is_jpeg) {
+			gpointer state = NULL;
+			GstMeta *meta;
+
+			while ((meta = gst_buffer_iterate_meta_filtered(buf, &state, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+				GeminiRequestData *req = gemini_request_data_new(self, buf);
+				if (set_request_roi(self, req, (GstVideoRegionOfInterestMeta *) meta)) {
+					g_ptr_array_add(requests, req);
 				} else {
-					GST_ERROR_OBJECT(self, "Failed to allocate memory for JPEG data copy");
-					gst_buffer_unmap(buf, &map);
-					return GST_FLOW_ERROR;
+					gemini_request_data_free(req);
 				}
 			}
-		
-			GeminiRequestData *req = g_new0(GeminiRequestData, 1);
-			req->image_data = jpeg_data;
-			req->image_size = jpeg_size;
-			req->api_key = g_strdup(self->api_key);
-			req->prompt = g_strdup(self->prompt);
-			req->model_name = g_strdup(self->model_name);
-			req->original_buffer = gst_buffer_ref(buf);
-			req->self = self;
-
-			// Copy generationConfig properties to request data
-			if (self->stop_sequences) {
-				req->stop_sequences = g_strdupv(self->stop_sequences);
+		} else if (self->batch_frames > 1) {
+			// Frames are sampled as usual but only sent once the batch is full
+			g_ptr_array_add(self->pending_batch, gemini_request_data_new(self, buf));
+			self->last_analysis_time_ns = current_time;
+			remember_scene(self);
+			if (self->pending_batch->len >= (guint) self->batch_frames) {
+				g_ptr_array_add(requests, take_batch(self));
 			} else {
-				req->stop_sequences = NULL;
+				GST_DEBUG_OBJECT(self, "Collected frame %u of %d for the next batch.", self->pending_batch->len, self->batch_frames);
 			}
-			req->temperature = self->temperature;
-			req->max_output_tokens = self->max_output_tokens;
-			req->top_p = self->top_p;
-			req->top_k = self->top_k;
-			
-			gst_buffer_unmap(buf, &map);
-			
-			self->analysis_in_progress = TRUE;
-			self->last_analysis_time_ns = current_time;
-			
-			g_async_queue_push(self->request_queue, req);
-			GST_DEBUG_OBJECT(self, "Queued frame for analysis.");
 		} else {
-			GST_WARNING_OBJECT(self, "Failed to map buffer for analysis.");
+			g_ptr_array_add(requests, gemini_request_data_new(self, buf));
+		}
+
+		if (requests->len > 0) {
+			queue_analysis(self, requests);
+			self->last_analysis_time_ns = current_time;
+			remember_scene(self);
+			GST_DEBUG_OBJECT(self, "Queued frame for analysis in %u request(s).", requests->len);
+		} else if (self->roi_analysis && !self->input_is_jpeg) {
+			// Nothing upstream found worth describing, try the next frame
+			GST_DEBUG_OBJECT(self, "No regions of interest on this frame.");
 		}
+		g_ptr_array_free(requests, TRUE);
+	}
+
+	if (self->output_metadata && self->roi_analysis) {
+		apply_roi_descriptions(self, buf);
 	}
   
 	if (self->output_metadata && self->pending_description) {
@@ -926,6 +3582,41 @@ gst_gemini_vision_transform_ip (GstBaseTransform * trans, GstBuffer * buf) {
   	return GST_FLOW_OK;
 }
 
+static gboolean
+gst_gemini_vision_sink_event (GstBaseTransform * trans, GstEvent * event) {
+	GstGeminiVision *self = GST_GEMINI_VISION (trans);
+
+	switch (GST_EVENT_TYPE(event)) {
+		case GST_EVENT_FLUSH_STOP:
+			// Frames from before a seek show a position that was left
+			if (self->pending_batch->len > 0) {
+				GST_DEBUG_OBJECT(self, "Dropping a batch of %u frame(s) on flush.", self->pending_batch->len);
+				clear_pending_batch(self);
+			}
+			break;
+		case GST_EVENT_SEGMENT:
+		case GST_EVENT_EOS:
+			// The frames of an incomplete batch were picked for analysis as
+			// well, and frames of the next segment do not join them
+			if (self->pending_batch->len > 0 && self->worker_running) {
+				GPtrArray *requests = g_ptr_array_new();
+
+				GST_DEBUG_OBJECT(
+					self, 
+					"Sending the last batch of the segment with %u frame(s).", 
+					self->pending_batch->len
+				);
+				g_ptr_array_add(requests, take_batch(self));
+				queue_analysis(self, requests);
+				g_ptr_array_free(requests, TRUE);
+			}
+			break;
+		default:
+			break;
+	}
+	return GST_BASE_TRANSFORM_CLASS(gst_gemini_vision_parent_class)->sink_event(trans, event);
+}
+
 static void
 gst_gemini_vision_set_property (
 	GObject * object, 
@@ -935,41 +3626,144 @@ gst_gemini_vision_set_property (
 ){
   	GstGeminiVision *self = GST_GEMINI_VISION (object);
 
-	switch (prop_id) {
-		case PROP_API_KEY:
-			g_free(self->api_key);
-			self->api_key = g_value_dup_string (value);
+	switch (prop_id) {
+		case PROP_API_KEY:
+			g_free(self->api_key);
+			self->api_key = g_value_dup_string (value);
+			break;
+		case PROP_PROMPT:
+			g_free(self->prompt);
+			self->prompt = g_value_dup_string (value);
+			break;
+		case PROP_MODEL_NAME:
+			g_free(self->model_name);
+			self->model_name = g_value_dup_string (value);
+			break;
+		case PROP_ANALYSIS_INTERVAL:
+			self->analysis_interval_sec = g_value_get_double (value);
+			self->analysis_interval = GST_SECOND * self->analysis_interval_sec;
+			break;
+		case PROP_OUTPUT_METADATA:
+			self->output_metadata = g_value_get_boolean (value);
+			break;
+		case PROP_STOP_SEQUENCES:
+			if (self->stop_sequences) g_strfreev(self->stop_sequences);
+			self->stop_sequences = g_value_dup_boxed(value); // For G_TYPE_STRV
+			break;
+		case PROP_TEMPERATURE:
+			self->temperature = g_value_get_double(value);
+			break;
+		case PROP_MAX_OUTPUT_TOKENS:
+			self->max_output_tokens = g_value_get_int(value);
+			break;
+		case PROP_TOP_P:
+			self->top_p = g_value_get_double(value);
+			break;
+		case PROP_TOP_K:
+			self->top_k = g_value_get_int(value);
+			break;
+		case PROP_MAX_WIDTH:
+			self->max_width = g_value_get_int(value);
+			break;
+		case PROP_MAX_HEIGHT:
+			self->max_height = g_value_get_int(value);
+			break;
+		case PROP_MATCH_MODEL_TILE:
+			self->match_model_tile = g_value_get_boolean(value);
+			break;
+		case PROP_ENCODER_THREADS:
+			self->encoder_threads = g_value_get_int(value);
+			break;
+		case PROP_JPEG_QUALITY:
+			self->jpeg_quality = g_value_get_int(value);
+			break;
+		case PROP_TARGET_BYTES:
+			self->target_bytes = g_value_get_uint(value);
+			break;
+		case PROP_ENCODER_PROFILE:
+			self->encoder_profile = g_value_get_enum(value);
+			break;
+		case PROP_GRAYSCALE:
+			self->grayscale = g_value_get_boolean(value);
+			break;
+		case PROP_ROI_ANALYSIS:
+			self->roi_analysis = g_value_get_boolean(value);
+			break;
+		case PROP_ROI_PADDING:
+			self->roi_padding = g_value_get_int(value);
+			break;
+		case PROP_MAX_INFLIGHT:
+			self->max_inflight = g_value_get_int(value);
+			break;
+		case PROP_ORDERED_RESULTS:
+			self->ordered_results = g_value_get_boolean(value);
+			break;
+		case PROP_STREAM_RESPONSES:
+			self->stream_responses = g_value_get_boolean(value);
+			break;
+		case PROP_MAX_RETRIES:
+			self->max_retries = g_value_get_int(value);
+			break;
+		case PROP_MAX_RESULT_AGE:
+			self->max_result_age_sec = g_value_get_double(value);
+			break;
+		case PROP_SHARED_DISPATCHER:
+			self->shared_dispatcher = g_value_get_boolean(value);
+			break;
+		case PROP_PRIORITY:
+			self->priority = g_value_get_int(value);
+			break;
+		case PROP_MAX_RPM:
+			self->max_rpm = g_value_get_int(value);
+			break;
+		case PROP_SHARED_MAX_TRANSFERS:
+			self->shared_max_transfers = g_value_get_int(value);
+			break;
+		case PROP_BATCH_FRAMES:
+			self->batch_frames = g_value_get_int(value);
+			break;
+		case PROP_API_ENDPOINT: {
+			const gchar *endpoint = g_value_get_string(value);
+
+			g_free(self->api_endpoint);
+			if (!endpoint || endpoint[0] == '\0') {
+				endpoint = GEMINI_DEFAULT_API_ENDPOINT;
+			}
+			// Paths are appended with a slash of their own
+			self->api_endpoint = g_strdup(endpoint);
+			while (g_str_has_suffix(self->api_endpoint, "/")) {
+				self->api_endpoint[strlen(self->api_endpoint) - 1] = '\0';
+			}
 			break;
-		case PROP_PROMPT:
-			g_free(self->prompt);
-			self->prompt = g_value_dup_string (value);
+		}
+		case PROP_CACHE_PROMPT:
+			self->cache_prompt = g_value_get_boolean(value);
 			break;
-		case PROP_MODEL_NAME:
-			g_free(self->model_name);
-			self->model_name = g_value_dup_string (value);
+		case PROP_CACHE_TTL:
+			self->cache_ttl = g_value_get_int(value);
 			break;
-		case PROP_ANALYSIS_INTERVAL:
-			self->analysis_interval_sec = g_value_get_double (value);
-			self->analysis_interval = GST_SECOND * self->analysis_interval_sec;
+		case PROP_PREWARM:
+			self->prewarm = g_value_get_boolean(value);
 			break;
-		case PROP_OUTPUT_METADATA:
-			self->output_metadata = g_value_get_boolean (value);
+		case PROP_SCENE_THRESHOLD:
+			self->scene_threshold = g_value_get_double(value);
 			break;
-		case PROP_STOP_SEQUENCES:
-			if (self->stop_sequences) g_strfreev(self->stop_sequences);
-			self->stop_sequences = g_value_dup_boxed(value); // For G_TYPE_STRV
+		case PROP_MAX_ANALYSIS_INTERVAL:
+			self->max_analysis_interval_sec = g_value_get_double(value);
+			self->max_analysis_interval = GST_SECOND * self->max_analysis_interval_sec;
 			break;
-		case PROP_TEMPERATURE:
-			self->temperature = g_value_get_double(value);
+		case PROP_DESCRIPTION_CACHE_SIZE:
+			self->description_cache_size = g_value_get_int(value);
 			break;
-		case PROP_MAX_OUTPUT_TOKENS:
-			self->max_output_tokens = g_value_get_int(value);
+		case PROP_DESCRIPTION_CACHE_DISTANCE:
+			self->description_cache_distance = g_value_get_int(value);
 			break;
-		case PROP_TOP_P:
-			self->top_p = g_value_get_double(value);
+		case PROP_RECORD_FILE:
+			g_free(self->record_file);
+			self->record_file = g_value_dup_string(value);
 			break;
-		case PROP_TOP_K:
-			self->top_k = g_value_get_int(value);
+		case PROP_RECORD_MODE:
+			self->record_mode = g_value_get_enum(value);
 			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1017,6 +3811,116 @@ gst_gemini_vision_get_property (
 		case PROP_TOP_K:
 			g_value_set_int(value, self->top_k);
 			break;
+		case PROP_MAX_WIDTH:
+			g_value_set_int(value, self->max_width);
+			break;
+		case PROP_MAX_HEIGHT:
+			g_value_set_int(value, self->max_height);
+			break;
+		case PROP_MATCH_MODEL_TILE:
+			g_value_set_boolean(value, self->match_model_tile);
+			break;
+		case PROP_ENCODER_THREADS:
+			g_value_set_int(value, self->encoder_threads);
+			break;
+		case PROP_JPEG_QUALITY:
+			g_value_set_int(value, self->jpeg_quality);
+			break;
+		case PROP_TARGET_BYTES:
+			g_value_set_uint(value, self->target_bytes);
+			break;
+		case PROP_ENCODER_PROFILE:
+			g_value_set_enum(value, self->encoder_profile);
+			break;
+		case PROP_GRAYSCALE:
+			g_value_set_boolean(value, self->grayscale);
+			break;
+		case PROP_ROI_ANALYSIS:
+			g_value_set_boolean(value, self->roi_analysis);
+			break;
+		case PROP_ROI_PADDING:
+			g_value_set_int(value, self->roi_padding);
+			break;
+		case PROP_MAX_INFLIGHT:
+			g_value_set_int(value, self->max_inflight);
+			break;
+		case PROP_ORDERED_RESULTS:
+			g_value_set_boolean(value, self->ordered_results);
+			break;
+		case PROP_STREAM_RESPONSES:
+			g_value_set_boolean(value, self->stream_responses);
+			break;
+		case PROP_MAX_RETRIES:
+			g_value_set_int(value, self->max_retries);
+			break;
+		case PROP_MAX_RESULT_AGE:
+			g_value_set_double(value, self->max_result_age_sec);
+			break;
+		case PROP_SHARED_DISPATCHER:
+			g_value_set_boolean(value, self->shared_dispatcher);
+			break;
+		case PROP_PRIORITY:
+			g_value_set_int(value, self->priority);
+			break;
+		case PROP_MAX_RPM:
+			g_value_set_int(value, self->max_rpm);
+			break;
+		case PROP_SHARED_MAX_TRANSFERS:
+			g_value_set_int(value, self->shared_max_transfers);
+			break;
+		case PROP_BATCH_FRAMES:
+			g_value_set_int(value, self->batch_frames);
+			break;
+		case PROP_API_ENDPOINT:
+			g_value_set_string(value, self->api_endpoint);
+			break;
+		case PROP_CACHE_PROMPT:
+			g_value_set_boolean(value, self->cache_prompt);
+			break;
+		case PROP_CACHE_TTL:
+			g_value_set_int(value, self->cache_ttl);
+			break;
+		case PROP_PREWARM:
+			g_value_set_boolean(value, self->prewarm);
+			break;
+		case PROP_SCENE_THRESHOLD:
+			g_value_set_double(value, self->scene_threshold);
+			break;
+		case PROP_MAX_ANALYSIS_INTERVAL:
+			g_value_set_double(value, self->max_analysis_interval_sec);
+			break;
+		case PROP_DESCRIPTION_CACHE_SIZE:
+			g_value_set_int(value, self->description_cache_size);
+			break;
+		case PROP_DESCRIPTION_CACHE_DISTANCE:
+			g_value_set_int(value, self->description_cache_distance);
+			break;
+		case PROP_DESCRIPTION_CACHE_HITS:
+			g_mutex_lock(&self->description_cache_lock);
+			g_value_set_uint64(value, self->description_cache_hits);
+			g_mutex_unlock(&self->description_cache_lock);
+			break;
+		case PROP_DESCRIPTION_CACHE_MISSES:
+			g_mutex_lock(&self->description_cache_lock);
+			g_value_set_uint64(value, self->description_cache_misses);
+			g_mutex_unlock(&self->description_cache_lock);
+			break;
+		case PROP_RECORD_FILE:
+			g_value_set_string(value, self->record_file);
+			break;
+		case PROP_RECORD_MODE:
+			g_value_set_enum(value, self->record_mode);
+			break;
+		case PROP_HTTP_VERSION:
+			GST_OBJECT_LOCK(self);
+			g_value_set_string(value, self->http_version ? http_version_name(self->http_version) : NULL);
+			GST_OBJECT_UNLOCK(self);
+			break;
+		case PROP_MAX_STREAMS_IN_FLIGHT:
+			GST_OBJECT_LOCK(self);
+			g_value_set_uint(value, self->max_streams);
+			GST_OBJECT_UNLOCK(self);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 			break;
@@ -1041,7 +3945,7 @@ gst_gemini_vision_class_init (GstGeminiVisionClass * klass) {
 		GST_PAD_SINK,
 		GST_PAD_ALWAYS,
 		GST_STATIC_CAPS(
-			"video/x-raw, format={RGB, BGR, RGBA, BGRA}; "
+			"video/x-raw, format={RGB, BGR, RGBA, BGRA, RGBx, BGRx, xRGB, xBGR, ARGB, ABGR, I420, YV12, NV12, NV21, YUY2, UYVY, YVYU}; "
 			"image/jpeg"
 		)
 	);
@@ -1051,7 +3955,7 @@ gst_gemini_vision_class_init (GstGeminiVisionClass * klass) {
 		GST_PAD_SRC,
 		GST_PAD_ALWAYS,
 		GST_STATIC_CAPS(
-			"video/x-raw, format={RGB, BGR, RGBA, BGRA}; "
+			"video/x-raw, format={RGB, BGR, RGBA, BGRA, RGBx, BGRx, xRGB, xBGR, ARGB, ABGR, I420, YV12, NV12, NV21, YUY2, UYVY, YVYU}; "
 			"image/jpeg"
 		)
 	);
@@ -1074,13 +3978,16 @@ gst_gemini_vision_class_init (GstGeminiVisionClass * klass) {
 	);
 
 	gobject_class->dispose = gst_gemini_vision_dispose;
+	gobject_class->finalize = gst_gemini_vision_finalize;
 	gobject_class->set_property = gst_gemini_vision_set_property;
 	gobject_class->get_property = gst_gemini_vision_get_property;
   
 	base_transform_class->start = gst_gemini_vision_start;
 	base_transform_class->stop = gst_gemini_vision_stop;
 	base_transform_class->set_caps = gst_gemini_vision_set_caps;
+	base_transform_class->propose_allocation = gst_gemini_vision_propose_allocation;
 	base_transform_class->transform_ip = gst_gemini_vision_transform_ip;
+	base_transform_class->sink_event = gst_gemini_vision_sink_event;
 
 	g_object_class_install_property (
 		gobject_class, 
@@ -1196,6 +4103,378 @@ gst_gemini_vision_class_init (GstGeminiVisionClass * klass) {
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
 		));
 
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_MAX_WIDTH,
+		g_param_spec_int(
+			"max-width", 
+			"Max Width",
+			"Raw frames wider than this are downscaled before encoding, keeping the aspect ratio. 0 means no limit.",
+			0, 
+			G_MAXINT, 
+			0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_MAX_HEIGHT,
+		g_param_spec_int(
+			"max-height", 
+			"Max Height",
+			"Raw frames taller than this are downscaled before encoding, keeping the aspect ratio. 0 means no limit.",
+			0, 
+			G_MAXINT, 
+			0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_MATCH_MODEL_TILE,
+		g_param_spec_boolean(
+			"match-model-tile", 
+			"Match Model Tile",
+			"Downscale raw frames to fit a single 768x768 model tile. Combined with max-width/max-height the smaller limit wins.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_ENCODER_THREADS,
+		g_param_spec_int(
+			"encoder-threads", 
+			"Encoder Threads",
+			"Number of threads compressing horizontal stripes of a raw frame in parallel. 1 encodes on a single thread, 0 uses one thread per CPU core.",
+			0, 
+			GEMINI_MAX_ENCODER_THREADS, 
+			1, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_JPEG_QUALITY,
+		g_param_spec_int(
+			"jpeg-quality", 
+			"JPEG Quality",
+			"Quality of JPEG images encoded from raw frames. With target-bytes set this is the highest quality used.",
+			1, 
+			100, 
+			85, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_TARGET_BYTES,
+		g_param_spec_uint(
+			"target-bytes", 
+			"Target Bytes",
+			"Adjust the JPEG quality from frame to frame so encoded raw frames come close to this size. 0 keeps jpeg-quality fixed.",
+			0, 
+			G_MAXUINT, 
+			0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_ENCODER_PROFILE,
+		g_param_spec_enum(
+			"encoder-profile", 
+			"Encoder Profile",
+			"libjpeg settings for raw frames: fast (integer DCT, 4:2:0), balanced (accurate DCT, input chroma kept) or small (accurate DCT, 4:2:0, optimized Huffman tables, no parallel stripes).",
+			GST_TYPE_GEMINI_ENCODER_PROFILE, 
+			GST_GEMINI_ENCODER_PROFILE_BALANCED, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property(
+		gobject_class, 
+		PROP_GRAYSCALE,
+		g_param_spec_boolean(
+			"grayscale", 
+			"Grayscale",
+			"Encode raw frames as grayscale JPEG images.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_ROI_ANALYSIS,
+		g_param_spec_boolean(
+			"roi-analysis", 
+			"ROI Analysis",
+			"Send each GstVideoRegionOfInterestMeta region of a raw frame as its own request instead of the whole frame. Frames without regions are skipped.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_ROI_PADDING,
+		g_param_spec_int(
+			"roi-padding", 
+			"ROI Padding",
+			"Pixels of context added on every side of a region before it is cropped.",
+			0, G_MAXINT, 0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_MAX_INFLIGHT,
+		g_param_spec_int(
+			"max-inflight", 
+			"Max In-flight",
+			"Maximum number of API requests running at the same time. A new frame is analyzed once fewer are in flight, the regions of one frame are always sent together.",
+			1, GEMINI_MAX_INFLIGHT, 1, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_ORDERED_RESULTS,
+		g_param_spec_boolean(
+			"ordered-results", 
+			"Ordered Results",
+			"Deliver descriptions in the order of the analyzed frames. When false each description is delivered as soon as it arrives.",
+			TRUE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_STREAM_RESPONSES,
+		g_param_spec_boolean(
+			"stream-responses", 
+			"Stream Responses",
+			"Use streamGenerateContent and deliver the text of whole-frame analyses while it is generated, as metadata or through description-partial.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_MAX_RETRIES,
+		g_param_spec_int(
+			"max-retries", 
+			"Max Retries",
+			"Times a request is sent again after a network error, HTTP 408, 429 or 5xx, with exponential backoff and jitter. A Retry-After from the server is honoured and also holds back new analyses.",
+			0, GEMINI_MAX_RETRIES, 3, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_MAX_RESULT_AGE,
+		g_param_spec_double(
+			"max-result-age", 
+			"Max Result Age",
+			"Seconds after a frame is picked within which its description must arrive. Requests running longer are aborted and late results are dropped. 0 means no limit.",
+			0.0, 3600.0, 0.0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_SHARED_DISPATCHER,
+		g_param_spec_boolean(
+			"shared-dispatcher", 
+			"Shared Dispatcher",
+			"Send requests through one dispatcher shared by all elements in the process that set this, with one thread, shared connections and common limits, instead of a worker thread of its own.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_PRIORITY,
+		g_param_spec_int(
+			"priority", 
+			"Priority",
+			"With shared-dispatcher, requests of elements with a higher priority are sent first. Elements of equal priority take turns.",
+			0, 100, 0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_MAX_RPM,
+		g_param_spec_int(
+			"max-rpm", 
+			"Max Requests Per Minute",
+			"Requests started per minute, retries included. With shared-dispatcher the limit is process-wide and the lowest one set applies. 0 means no limit.",
+			0, G_MAXINT, 0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_SHARED_MAX_TRANSFERS,
+		g_param_spec_int(
+			"shared-max-transfers", 
+			"Shared Max Transfers",
+			"Requests the shared dispatcher runs at once for all its elements, the lowest value set applies. Only used with shared-dispatcher.",
+			1, 256, 16, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_BATCH_FRAMES,
+		g_param_spec_int(
+			"batch-frames", 
+			"Batch Frames",
+			"Number of frames picked at analysis-interval that are sent together in one request. The model answers for each frame, and each description is delivered with its own frame. Not used with roi-analysis.",
+			1, GEMINI_MAX_BATCH_FRAMES, 1, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_API_ENDPOINT,
+		g_param_spec_string(
+			"api-endpoint", 
+			"API Endpoint",
+			"Base URL the model and cachedContents paths are appended to, e.g. a local stand-in for testing.",
+			GEMINI_DEFAULT_API_ENDPOINT, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_CACHE_PROMPT,
+		g_param_spec_boolean(
+			"cache-prompt", 
+			"Cache Prompt",
+			"Store the prompt as cached content on the first request and refer to it by name instead of sending it each time. The model has to support context caching and the prompt has to reach its minimum token count, otherwise the prompt is sent as usual.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_CACHE_TTL,
+		g_param_spec_int(
+			"cache-ttl", 
+			"Cache TTL",
+			"Seconds the cached prompt is kept for. It is extended while the element keeps sending requests and deleted when the element stops.",
+			GEMINI_MIN_CACHE_TTL, GEMINI_MAX_CACHE_TTL, 3600, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_PREWARM,
+		g_param_spec_boolean(
+			"prewarm", 
+			"Prewarm",
+			"Open the connection to the API when the element starts and set up the encoder once the caps are known, so the first analysis only waits for the upload and the model. The connection request also checks the API key and model name.",
+			FALSE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_SCENE_THRESHOLD,
+		g_param_spec_double(
+			"scene-threshold", 
+			"Scene Threshold",
+			"Only analyze a raw frame once its mean luma difference to the last analyzed frame, compared on small thumbnails, reaches this fraction of full scale. analysis-interval is then the shortest time between analyses. 0 analyzes at every analysis-interval.",
+			0.0, 1.0, 0.0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_MAX_ANALYSIS_INTERVAL,
+		g_param_spec_double(
+			"max-analysis-interval", 
+			"Max Analysis Interval",
+			"With scene-threshold, seconds after which a frame is analyzed even if the scene did not change. 0 means never.",
+			0.0, 86400.0, 0.0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_DESCRIPTION_CACHE_SIZE,
+		g_param_spec_int(
+			"description-cache-size", 
+			"Description Cache Size",
+			"Number of descriptions kept by perceptual hash of the raw frame they describe. A frame that looks like one of them gets its description without a request. Kept until the element is finalized. 0 disables the cache.",
+			0, GEMINI_MAX_DESCRIPTION_CACHE_SIZE, 0, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_DESCRIPTION_CACHE_DISTANCE,
+		g_param_spec_int(
+			"description-cache-distance", 
+			"Description Cache Distance",
+			"Most bits out of 64 in which the perceptual hashes of two frames may differ for one to reuse the description of the other. 0 only matches frames that hash alike.",
+			0, GEMINI_MAX_DESCRIPTION_CACHE_DISTANCE, 2, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_DESCRIPTION_CACHE_HITS,
+		g_param_spec_uint64(
+			"description-cache-hits", 
+			"Description Cache Hits",
+			"Frames answered from the description cache",
+			0, G_MAXUINT64, 0, 
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_DESCRIPTION_CACHE_MISSES,
+		g_param_spec_uint64(
+			"description-cache-misses", 
+			"Description Cache Misses",
+			"Frames looked up in the description cache and sent to the API",
+			0, G_MAXUINT64, 0, 
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_RECORD_FILE,
+		g_param_spec_string(
+			"record-file", 
+			"Record File",
+			"File in which every response is recorded under a digest of its request, the JPEG images, prompt, model and generation config. A request recorded before is answered from the file instead of the API, see record-mode.",
+			NULL, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_RECORD_MODE,
+		g_param_spec_enum(
+			"record-mode", 
+			"Record Mode",
+			"How record-file is used: read-write replays recorded responses and records the others, replay never sends a request (no API key needed), record sends every request and records the responses.",
+			GST_TYPE_GEMINI_RECORD_MODE, 
+			GST_GEMINI_RECORD_MODE_READ_WRITE, 
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_HTTP_VERSION,
+		g_param_spec_string(
+			"http-version", 
+			"HTTP Version",
+			"Protocol the last finished request was carried over, e.g. HTTP/2 or HTTP/1.1. NULL until a request has finished.",
+			NULL, 
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		));
+	g_object_class_install_property (
+		gobject_class, 
+		PROP_MAX_STREAMS_IN_FLIGHT,
+		g_param_spec_uint(
+			"max-streams-in-flight", 
+			"Max Streams In Flight",
+			"Most requests running at once since the element started, counted as each request finished. Over HTTP/2 they were streams of one connection. With shared-dispatcher the requests of all its elements count.",
+			0, G_MAXUINT, 0, 
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		));
+
 	// --- Define Signals ---
 	guint signals[LAST_SIGNAL] = {0};
 	signals[SIGNAL_DESCRIPTION_RECEIVED] =
@@ -1210,6 +4489,36 @@ gst_gemini_vision_class_init (GstGeminiVisionClass * klass) {
 			G_TYPE_STRING, 
 			GST_TYPE_BUFFER
 		);
+	// Emitted with the text generated so far when stream-responses is set,
+	// description-received still follows with the complete text
+	signals[SIGNAL_DESCRIPTION_PARTIAL] =
+		g_signal_new (
+			"description-partial", 
+			G_TYPE_FROM_CLASS (klass),
+			G_SIGNAL_RUN_LAST,
+			0,
+			NULL, NULL, NULL,
+			G_TYPE_NONE, 
+			2, 
+			G_TYPE_STRING, 
+			GST_TYPE_BUFFER
+		);
+	// Emitted instead of description-received for each region when
+	// roi-analysis is set: description, buffer, region id and region type
+	signals[SIGNAL_ROI_DESCRIPTION_RECEIVED] =
+		g_signal_new (
+			"roi-description-received", 
+			G_TYPE_FROM_CLASS (klass),
+			G_SIGNAL_RUN_LAST,
+			0,
+			NULL, NULL, NULL,
+			G_TYPE_NONE, 
+			4, 
+			G_TYPE_STRING, 
+			GST_TYPE_BUFFER,
+			G_TYPE_INT,
+			G_TYPE_STRING
+		);
 
 	// Ensure metadata is registered
 	gst_gemini_description_meta_get_info();
@@ -1217,7 +4526,7 @@ gst_gemini_vision_class_init (GstGeminiVisionClass * klass) {
 
 static void
 gst_gemini_vision_init (GstGeminiVision * self) {
-	self->request_queue = g_async_queue_new();
+	self->encode_queue = g_async_queue_new();
 	self->result_queue = g_async_queue_new();
 
 	self->api_key = NULL;
@@ -1234,15 +4543,83 @@ gst_gemini_vision_init (GstGeminiVision * self) {
 	self->top_p = 0.8;           // Default from example
 	self->top_k = 10;            // Default from example
 
+	self->max_width = 0;
+	self->max_height = 0;
+	self->match_model_tile = FALSE;
+	self->scale_src_width = 0;
+	self->scale_src_height = 0;
+	self->scale_input = FALSE;
+	self->scaled_buffer = NULL;
+	self->scale_lines = NULL;
+	self->scale_lines_size = 0;
+	memset(self->scalers, 0, sizeof(self->scalers));
+	gst_video_info_init(&self->scaled_video_info);
+	gst_video_info_init(&self->encode_video_info);
+	gst_gemini_jpeg_encoder_init(&self->jpeg_encoder);
+
+	self->encoder_threads = 1;
+	self->jpeg_quality = 85;
+	self->target_bytes = 0;
+	self->encoder_profile = GST_GEMINI_ENCODER_PROFILE_BALANCED;
+	self->grayscale = FALSE;
+	self->roi_analysis = FALSE;
+	self->roi_padding = 0;
+	self->max_inflight = 1;
+	self->ordered_results = TRUE;
+	self->stream_responses = FALSE;
+	self->max_retries = 3;
+	self->max_result_age_sec = 0.0;
+	self->shared_dispatcher = FALSE;
+	self->priority = 0;
+	self->max_rpm = 0;
+	self->shared_max_transfers = 16;
+	self->batch_frames = 1;
+	self->pending_batch = g_ptr_array_new();
+	self->api_endpoint = g_strdup(GEMINI_DEFAULT_API_ENDPOINT);
+	self->cache_prompt = FALSE;
+	self->cache_ttl = 3600;
+	self->cache_name = NULL;
+	self->prewarm = FALSE;
+	self->scene_threshold = 0.0;
+	self->max_analysis_interval_sec = 0.0;
+	self->max_analysis_interval = 0;
+	self->has_scene_reference = FALSE;
+	self->description_cache_size = 0;
+	self->description_cache_distance = 2;
+	g_mutex_init(&self->description_cache_lock);
+	g_queue_init(&self->description_cache);
+	self->description_cache_hits = 0;
+	self->description_cache_misses = 0;
+	self->settings_digest = NULL;
+	self->record_file = NULL;
+	self->record_mode = GST_GEMINI_RECORD_MODE_READ_WRITE;
+	self->record = NULL;
+	self->backoff_until = 0;
+	self->adaptive_quality = 85;
+	self->stripe_pool = NULL;
+	self->stripe_encoders = NULL;
+	self->n_stripe_encoders = 0;
+	self->stripes_pending = 0;
+	g_mutex_init(&self->stripe_lock);
+	g_cond_init(&self->stripe_cond);
 
 	self->worker_running = FALSE;
-	self->worker_thread = NULL;
+	self->encoder_thread = NULL;
 	self->result_source = NULL;
+	self->dispatcher = NULL;
+	self->http_version = 0;
+	self->max_streams = 0;
 	
 	gst_video_info_init(&self->input_video_info);
-	self->analysis_in_progress = FALSE;
+	self->requests_in_flight = 0;
+	self->request_seq = 0;
+	self->delivery_seq = 0;
+	self->held_results = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) gemini_result_data_free);
+	self->analysis_id = 0;
 	self->analysis_interval = GST_SECOND * self->analysis_interval_sec;
 	self->last_analysis_time_ns = 0;
 	self->pending_description = NULL;
+	self->roi_descriptions = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+	self->roi_descriptions_analysis = 0;
 	self->input_is_jpeg = FALSE;
 }
\ No newline at end of file
@@ -6,6 +6,11 @@
 #include <gst/video/gstvideometa.h> // For GstVideoMeta and GstVideoInfo
 #include <json-c/json.h>           // For json-c
 #include <curl/curl.h>             // For CURL
+#include "gstgeminibody.h"
+#include "gstgeminiconvert.h"
+#include "gstgeminijpeg.h"
+#include "gstgeminirecord.h"
+#include "gstgeminiresponse.h"
 
 GST_DEBUG_CATEGORY_EXTERN (gst_gemini_vision_debug_category);
 
@@ -21,6 +26,37 @@ G_BEGIN_DECLS
 typedef struct _GstGeminiVision GstGeminiVision;
 typedef struct _GstGeminiVisionClass GstGeminiVisionClass;
 
+// Sends the requests of one element, or of all that share it, on its own
+// thread. Defined in gstgeminivision.c.
+typedef struct _GeminiDispatcher GeminiDispatcher;
+
+// libjpeg settings trading encode time against payload size
+typedef enum {
+	GST_GEMINI_ENCODER_PROFILE_FAST,      // Fast integer DCT, 4:2:0
+	GST_GEMINI_ENCODER_PROFILE_BALANCED,  // Accurate DCT, input chroma subsampling kept
+	GST_GEMINI_ENCODER_PROFILE_SMALL      // Accurate DCT, 4:2:0, optimized Huffman tables
+} GstGeminiEncoderProfile;
+
+#define GST_TYPE_GEMINI_ENCODER_PROFILE (gst_gemini_encoder_profile_get_type())
+GType gst_gemini_encoder_profile_get_type (void);
+
+// How record-file is used
+typedef enum {
+	GST_GEMINI_RECORD_MODE_READ_WRITE,  // Replay recorded responses, send and record the rest
+	GST_GEMINI_RECORD_MODE_REPLAY,      // Replay recorded responses, never send a request
+	GST_GEMINI_RECORD_MODE_RECORD       // Send every request and record the responses
+} GstGeminiRecordMode;
+
+#define GST_TYPE_GEMINI_RECORD_MODE (gst_gemini_record_mode_get_type())
+GType gst_gemini_record_mode_get_type (void);
+
+// What a request does with the cached prompt instead of analyzing a frame
+typedef enum {
+	GEMINI_CACHE_OP_NONE,
+	GEMINI_CACHE_OP_CREATE,   // Stores the prompt as cached content
+	GEMINI_CACHE_OP_REFRESH   // Extends the TTL of cached_content
+} GeminiCacheOp;
+
 // Custom Metadata for Gemini Description
 #define GST_GEMINI_DESCRIPTION_META_API_TYPE (gst_gemini_description_meta_api_get_type())
 #define GST_GEMINI_DESCRIPTION_META_INFO (gst_gemini_description_meta_get_info())
@@ -39,11 +75,35 @@ GstGeminiDescriptionMeta *gst_buffer_add_gemini_description_meta (GstBuffer *buf
 
 // Structure to hold data for asynchronous requests
 typedef struct _GeminiRequestData {
-	guchar *image_data;
-	gsize image_size;
+	GstBuffer *image; // JPEG to upload, filled in by the encoder thread
+	GstVideoInfo video_info; // Layout of original_buffer when it is raw video
+	gboolean is_jpeg; // original_buffer already holds a JPEG
+	guint analysis_id;
+	guint seq; // Position of the request in PTS order
+	gboolean stream; // Request a server-sent event stream
+	gint max_retries; // Attempts after the first one for transient failures
+	gint64 deadline; // Monotonic time after which the answer is useless, 0 for none
+	gint64 frame_deadline; // Deadline of the carrier's own description when deadline covers a batch
+	GPtrArray *batch; // Later frames sent in the same request, GeminiRequestData
+	gboolean prewarm; // Sets up the connection, or the encoder when it has a frame, nothing is analyzed
+	GeminiCacheOp cache_op; // Creates or extends the cached prompt, nothing is analyzed
+	gboolean has_phash; // phash was computed, the description is cached when it arrives
+	guint64 phash; // Perceptual hash of the frame or region, see description-cache-size
+	gboolean has_record_key; // record_key was computed, the response is recorded when it arrives
+	guint8 record_key[GST_GEMINI_RECORD_KEY_SIZE]; // Digest of the request, see record-file
+
+	// Region of original_buffer to analyze when has_roi is set, already
+	// padded, clamped to the frame and aligned to chroma samples
+	gboolean has_roi;
+	gint roi_id;
+	GQuark roi_type;
+	guint roi_x, roi_y, roi_width, roi_height;
+
+	gchar *api_endpoint;
 	gchar *api_key;
 	gchar *prompt;
 	gchar *model_name;
+	gchar *cached_content; // Name of the cached content holding the prompt, or NULL to send it
 	GstBuffer *original_buffer;
 	GstGeminiVision *self; // Changed from GstGeminiProcessor
 
@@ -60,6 +120,14 @@ typedef struct _GeminiResultData {
 	gchar *description;
 	GstBuffer *original_buffer;
 	GstGeminiVision *processor_element; // Changed from GstGeminiProcessor
+	guint analysis_id;
+	guint seq;
+	gboolean partial; // Text streamed so far, the request is still running
+	gint64 deadline; // Monotonic time after which it is not delivered, 0 for none
+	GPtrArray *batch; // Results of the later frames of a batch, GeminiResultData
+	gboolean has_roi;
+	gint roi_id;
+	GQuark roi_type;
 } GeminiResultData;
 
 
@@ -67,11 +135,41 @@ struct _GstGeminiVision {
 	GstBaseTransform parent;
 
 	// Properties
+	gchar *api_endpoint;        // Base URL of the API, without a trailing slash
 	gchar *api_key;
 	gchar *prompt;
 	gchar *model_name;
 	gdouble analysis_interval_sec;
 	gboolean output_metadata;
+	gint max_width;             // 0 means no limit
+	gint max_height;            // 0 means no limit
+	gboolean match_model_tile;  // Fit frames inside one model tile
+	gint encoder_threads;       // Stripes compressed in parallel, 0 means one per CPU
+	gint jpeg_quality;          // Fixed quality, or the ceiling with target_bytes
+	guint target_bytes;         // JPEG size to aim for, 0 disables adaptive quality
+	GstGeminiEncoderProfile encoder_profile;
+	gboolean grayscale;         // Encode luma only
+	gboolean roi_analysis;      // One request per GstVideoRegionOfInterestMeta
+	gint roi_padding;           // Pixels added around each region
+	gint max_inflight;          // Requests allowed to run at once
+	gboolean ordered_results;   // Deliver in PTS order rather than completion order
+	gboolean stream_responses;  // Use streamGenerateContent and deliver partial text
+	gint max_retries;           // Retries of transient failures per request
+	gdouble max_result_age_sec; // Seconds a description may take, 0 means no limit
+	gboolean shared_dispatcher; // Send through the process-wide dispatcher
+	gint priority;              // Served first by a shared dispatcher when higher
+	gint max_rpm;               // Requests started per minute, 0 means no limit
+	gint shared_max_transfers;  // Transfers the shared dispatcher runs at once
+	gint batch_frames;          // Sampled frames sent together in one request
+	gboolean cache_prompt;      // Send the prompt once as cached content
+	gint cache_ttl;             // Seconds the cached content is kept alive for
+	gboolean prewarm;           // Connect and set up the encoder before the first analysis
+	gdouble scene_threshold;    // Change from the last analyzed frame needed for a new analysis, 0 disables
+	gdouble max_analysis_interval_sec; // Analyze unchanged scenes after this long, 0 never
+	gint description_cache_size; // Descriptions kept by perceptual hash, 0 disables the cache
+	gint description_cache_distance; // Differing hash bits still counted as the same picture
+	gchar *record_file;         // Responses recorded on disk, NULL for none
+	GstGeminiRecordMode record_mode;
 
 	// generationConfig properties
 	gchar **stop_sequences;
@@ -81,20 +179,87 @@ struct _GstGeminiVision {
 	gint top_k;
 
 	// Internal state
-	GAsyncQueue *request_queue;
+	GAsyncQueue *encode_queue;  // Frames waiting for the encoder thread
+	GThread *encoder_thread;
 	GAsyncQueue *result_queue;
-	GThread *worker_thread;
 	gboolean worker_running;
 	GSource *result_source; // For main context processing of results
+	GeminiDispatcher *dispatcher; // Sends the requests while started
+	long http_version;      // Protocol of the last finished transfer, under the object lock
+	guint max_streams;      // Most transfers running at once as one finished, under the object lock
 
 	GstVideoInfo input_video_info;
 	gboolean input_is_jpeg;
 
-	gboolean analysis_in_progress;
+	// Owned by the encoder thread, reconfigured whenever a request carries a
+	// different video info than the previous one
+	GstVideoInfo encode_video_info;
+	GstGeminiRowConverter row_converter;
+
+	// Downscaling of raw input, used when the frame or region exceeds the
+	// limits. Set up again for each new size, the buffers are kept.
+	gint scale_src_width;                    // Size scaling is set up for, 0 for none yet
+	gint scale_src_height;
+	gboolean scale_input;
+	GstVideoInfo scaled_video_info;          // RGB, I420 or Y42B at the reduced size
+	GstGeminiRowConverter scaled_converter;
+	GstGeminiScaler scalers[3];              // One per plane, only [0] for RGB
+	GstBuffer *scaled_buffer;                // Holds the reduced frame
+	guint8 *scale_lines;                     // Converted or deinterleaved source lines
+	gsize scale_lines_size;
+
+	GstGeminiJpegEncoder jpeg_encoder;       // Kept across frames for raw input, also encodes the first stripe
+	gdouble adaptive_quality;                // Quality for the next frame when target_bytes is set
+
+	// Parallel stripe encoding, see encoder-threads
+	GThreadPool *stripe_pool;
+	GstGeminiJpegEncoder *stripe_encoders;   // One per stripe after the first
+	guint n_stripe_encoders;
+	GMutex stripe_lock;
+	GCond stripe_cond;
+	guint stripes_pending;                   // Stripes still running on the pool
+
+	// Cached content holding the prompt, see cache-prompt. Under the object
+	// lock, read by the encoder thread and set by the dispatcher thread.
+	gchar *cache_name;          // "cachedContents/...", NULL while there is none
+	gint64 cache_expires;       // Monotonic time the cached content expires at
+	gint64 cache_retry_at;      // Monotonic time before which creating or extending it is not tried again
+	gboolean cache_pending;     // A request creating or extending it has not ended yet
+
+	// Descriptions of recently analyzed pictures, most recently used first.
+	// Looked up by the encoder thread and filled by the dispatcher thread.
+	GMutex description_cache_lock;
+	GQueue description_cache;
+	guint64 description_cache_hits;
+	guint64 description_cache_misses;
+	gchar *settings_digest;     // Digest of what besides the images shapes a description, set in start
+
+	// Responses recorded on disk, see record-file. Open between start and stop.
+	GstGeminiRecord *record;
+
+	gint requests_in_flight;    // Requests queued or running, decremented as results arrive
+	guint request_seq;          // Next request number
+	guint delivery_seq;         // Next request number to deliver when ordered
+	GHashTable *held_results;   // seq -> GeminiResultData that arrived early
+	gint64 backoff_until;       // Monotonic time before which no analysis starts, under the object lock
+	guint analysis_id;          // Counts analyzed frames
+	GPtrArray *pending_batch;   // Frames collected for the next batch, streaming thread only
 	GstClockTime analysis_interval;
+	GstClockTime max_analysis_interval;
 	GstClockTime last_analysis_time_ns;
 
+	// Thumbnails for scene-threshold, streaming thread only
+	guint8 scene_thumbnail[GST_GEMINI_THUMBNAIL_SIZE];  // Of the frame being considered
+	gboolean has_scene_thumbnail;
+	guint8 scene_reference[GST_GEMINI_THUMBNAIL_SIZE];  // Of the last analyzed frame
+	gboolean has_scene_reference;
+
 	gchar *pending_description; // Description to be applied to subsequent buffers
+
+	// ROI id -> description from the latest analysis with regions, applied to
+	// matching regions of subsequent buffers. Protected by the object lock.
+	GHashTable *roi_descriptions;
+	guint roi_descriptions_analysis;
 };
 
 struct _GstGeminiVisionClass {
@@ -109,6 +274,8 @@ GType gst_gemini_vision_get_type (void);
 // Signals (optional, if not using metadata primarily)
 enum {
 	SIGNAL_DESCRIPTION_RECEIVED,
+	SIGNAL_ROI_DESCRIPTION_RECEIVED,
+	SIGNAL_DESCRIPTION_PARTIAL,
 	LAST_SIGNAL
 };
 
@@ -20,6 +20,10 @@ plugin_init (GstPlugin * plugin)
 		0,
 		"Gemini Vision Plugin"
 	);
+	// Not thread-safe on older libcurl, so done once here rather than in the
+	// worker threads. Plugins are never unloaded, so there is no cleanup.
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+
     // Register your element type here
     return gst_element_register (
 		plugin, 
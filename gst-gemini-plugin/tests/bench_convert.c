@@ -0,0 +1,125 @@
+// tests/bench_convert.c
+// Times the row converter kernels against the per-pixel loop that
+// encode_frame_to_jpeg() used before them, on 3840x2160 frames converted
+// row by row, and prints milliseconds per frame. Built on request, see
+// meson.build. A frame count given as argument changes the number of runs.
+#include "../src/gstgeminiconvert.c"
+
+#include <glib.h>
+#include <stdlib.h>
+
+#define FRAME_WIDTH 3840
+#define FRAME_HEIGHT 2160
+
+// The loops the kernels replaced, kept as the baseline. The format was
+// tested once per row.
+static void
+legacy_convert_row(GstVideoFormat format, const guint8 *src_row, guint8 *rgb_row, gint width) {
+	if (format == GST_VIDEO_FORMAT_BGR) {
+		for (int i = 0; i < width; i++) {
+			rgb_row[i*3 + 0] = src_row[i*3 + 2]; // R <- B
+			rgb_row[i*3 + 1] = src_row[i*3 + 1]; // G <- G
+			rgb_row[i*3 + 2] = src_row[i*3 + 0]; // B <- R
+		}
+	} else if (format == GST_VIDEO_FORMAT_RGBA || format == GST_VIDEO_FORMAT_RGBx) {
+		for (int i = 0; i < width; i++) {
+			rgb_row[i*3 + 0] = src_row[i*4 + 0]; // R
+			rgb_row[i*3 + 1] = src_row[i*4 + 1]; // G
+			rgb_row[i*3 + 2] = src_row[i*4 + 2]; // B
+		}
+	} else {
+		for (int i = 0; i < width; i++) {
+			rgb_row[i*3 + 0] = src_row[i*4 + 2]; // R <- B
+			rgb_row[i*3 + 1] = src_row[i*4 + 1]; // G <- G
+			rgb_row[i*3 + 2] = src_row[i*4 + 0]; // B <- R
+		}
+	}
+}
+
+typedef struct {
+	GstVideoFormat format;
+	const guint8 *src;
+	gsize src_stride;
+	guint8 *dst;
+} Frame;
+
+static gdouble
+time_legacy(const Frame *frame, guint n_frames) {
+	gint64 start = g_get_monotonic_time();
+
+	for (guint n = 0; n < n_frames; n++) {
+		for (gint y = 0; y < FRAME_HEIGHT; y++) {
+			legacy_convert_row(frame->format, frame->src + y * frame->src_stride, frame->dst, FRAME_WIDTH);
+		}
+	}
+	return (g_get_monotonic_time() - start) / 1000.0 / n_frames;
+}
+
+static gdouble
+time_kernel(const Frame *frame, const GstGeminiRowConverter *conv, GstGeminiRowConvertFunc func, guint n_frames) {
+	gint64 start = g_get_monotonic_time();
+
+	for (guint n = 0; n < n_frames; n++) {
+		for (gint y = 0; y < FRAME_HEIGHT; y++) {
+			func(conv, frame->src + y * frame->src_stride, frame->dst, FRAME_WIDTH);
+		}
+	}
+	return (g_get_monotonic_time() - start) / 1000.0 / n_frames;
+}
+
+static void
+report(const gchar *format, const gchar *impl, gdouble ms, gdouble legacy_ms) {
+	g_print("%-5s %-9s %7.2f ms/frame  %5.2fx\n", format, impl, ms, legacy_ms / ms);
+}
+
+int
+main(int argc, char **argv) {
+	static const GstVideoFormat formats[] = {
+		GST_VIDEO_FORMAT_BGR, GST_VIDEO_FORMAT_RGBA, GST_VIDEO_FORMAT_BGRx,
+	};
+	const guint n_frames = argc > 1 ? MAX(atoi(argv[1]), 1) : 20;
+	const gsize src_size = (gsize) FRAME_WIDTH * 4 * FRAME_HEIGHT;
+	guint8 *src = g_malloc(src_size);
+	guint8 *dst = g_malloc((gsize) FRAME_WIDTH * 3);
+
+	for (gsize i = 0; i < src_size; i++) {
+		src[i] = (i * 7 + (i >> 12)) & 0xff;
+	}
+	g_print("%dx%d, %u frames, cpu %s\n", FRAME_WIDTH, FRAME_HEIGHT, n_frames, gst_gemini_convert_get_cpu_impl());
+
+	for (guint f = 0; f < G_N_ELEMENTS(formats); f++) {
+		const gchar *name = gst_video_format_to_string(formats[f]);
+		GstGeminiRowConverter conv;
+		Frame frame;
+		gdouble legacy_ms;
+
+		g_assert_true(gst_gemini_row_converter_init(&conv, formats[f]));
+		frame.format = formats[f];
+		frame.src = src;
+		frame.src_stride = (gsize) FRAME_WIDTH * conv.src_pstride;
+		frame.dst = dst;
+
+		// Once untimed, so the first run does not pay for page faults
+		time_legacy(&frame, 1);
+		legacy_ms = time_legacy(&frame, n_frames);
+		report(name, "legacy", legacy_ms, legacy_ms);
+#ifdef GEMINI_HAVE_X86_KERNELS
+		if (__builtin_cpu_supports("ssse3")) {
+			report(name, "ssse3", time_kernel(&frame, &conv, convert_ssse3, n_frames), legacy_ms);
+		}
+		// There is no AVX2 kernel for 3-byte pixels
+		if (__builtin_cpu_supports("avx2") && conv.src_pstride == 4) {
+			report(name, "avx2", time_kernel(&frame, &conv, convert_avx2, n_frames), legacy_ms);
+		}
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+		report(name, "neon", time_kernel(&frame, &conv, convert_neon, n_frames), legacy_ms);
+#endif
+		// What the element runs, through the converter
+		report(name, "selected", time_kernel(&frame, &conv, conv.func, n_frames), legacy_ms);
+	}
+
+	g_free(dst);
+	g_free(src);
+	return 0;
+}
@@ -0,0 +1,168 @@
+// tests/test_body.c
+// Reads request bodies back through the curl callbacks with read sizes that
+// cut base64 groups and segments at every offset, and again after a rewind
+// as on a retry. The result must match the text with g_base64_encode()
+// output in place of the images.
+#include "../src/gstgeminibody.c"
+
+#include <glib.h>
+
+GST_DEBUG_CATEGORY (gst_gemini_vision_debug_category);
+
+// Image sizes with every remainder modulo 3, empty and larger than curl's
+// upload buffer included
+static const gsize image_sizes[] = { 0, 1, 2, 3, 4, 5, 47, 1000, 300001 };
+
+// Bytes curl asks for per callback, small primes cut groups everywhere
+static const gsize read_sizes[] = { 1, 2, 3, 5, 7, 13, 4093, 65536, GEMINI_BODY_UPLOAD_BUFFER_SIZE };
+
+typedef struct {
+	GstGeminiBody *body;
+	GString *expected;
+	GPtrArray *buffers;
+} BodyFixture;
+
+static GstBuffer *
+random_buffer(gsize size) {
+	GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
+	GstMapInfo map;
+
+	g_assert_true(gst_buffer_map(buffer, &map, GST_MAP_WRITE));
+	for (gsize i = 0; i < size; i++) {
+		map.data[i] = g_test_rand_int_range(0, 256);
+	}
+	gst_buffer_unmap(buffer, &map);
+	return buffer;
+}
+
+static void
+add_image(BodyFixture *fixture, gsize size) {
+	GstBuffer *buffer = random_buffer(size);
+	GstMapInfo map;
+	gchar *encoded;
+
+	g_assert_true(gst_gemini_body_add_base64(fixture->body, buffer));
+	g_assert_true(gst_buffer_map(buffer, &map, GST_MAP_READ));
+	encoded = g_base64_encode(map.data, map.size);
+	g_string_append(fixture->expected, encoded);
+	g_free(encoded);
+	gst_buffer_unmap(buffer, &map);
+	g_ptr_array_add(fixture->buffers, buffer);
+}
+
+static void
+add_text(BodyFixture *fixture, const gchar *text) {
+	gst_gemini_body_add_text(fixture->body, text, -1);
+	g_string_append(fixture->expected, text);
+}
+
+// A request of the shape the element builds: JSON around each image, and
+// images next to each other
+static void
+fixture_set_up(BodyFixture *fixture, gconstpointer data) {
+	fixture->body = gst_gemini_body_new();
+	fixture->expected = g_string_new(NULL);
+	fixture->buffers = g_ptr_array_new_with_free_func((GDestroyNotify) gst_buffer_unref);
+
+	add_text(fixture, "{\"contents\":[{\"parts\":[{\"text\":\"Describe\"}");
+	for (guint i = 0; i < G_N_ELEMENTS(image_sizes); i++) {
+		add_text(fixture, ",{\"inline_data\":{\"mime_type\":\"image/jpeg\",\"data\":\"");
+		add_image(fixture, image_sizes[i]);
+		add_text(fixture, "\"}}");
+	}
+	add_image(fixture, 7);
+	add_image(fixture, 8);
+	add_text(fixture, "]}]}");
+	g_assert_cmpuint(gst_gemini_body_get_size(fixture->body), ==, fixture->expected->len);
+}
+
+static void
+fixture_tear_down(BodyFixture *fixture, gconstpointer data) {
+	gst_gemini_body_free(fixture->body);
+	g_string_free(fixture->expected, TRUE);
+	// Unmapped and released by the body first
+	g_ptr_array_unref(fixture->buffers);
+}
+
+// Reads from the current position to the end, read_size bytes at a time
+// given as size items of 1 or 3 bytes, like curl may
+static GString *
+read_body(GstGeminiBody *body, gsize read_size) {
+	GString *out = g_string_new(NULL);
+	gchar *dest = g_malloc(read_size);
+	const size_t item = read_size % 3 == 0 ? 3 : 1;
+	size_t n;
+
+	while ((n = gst_gemini_body_read(dest, item, read_size / item, body)) > 0) {
+		g_assert_cmpuint(n, <=, read_size);
+		g_string_append_len(out, dest, n);
+	}
+	g_free(dest);
+	return out;
+}
+
+static void
+test_read(BodyFixture *fixture, gconstpointer data) {
+	for (guint i = 0; i < G_N_ELEMENTS(read_sizes); i++) {
+		GString *out;
+
+		g_assert_cmpint(gst_gemini_body_seek(fixture->body, 0, SEEK_SET), ==, CURL_SEEKFUNC_OK);
+		out = read_body(fixture->body, read_sizes[i]);
+		g_assert_cmpuint(out->len, ==, fixture->expected->len);
+		g_assert_cmpmem(out->str, out->len, fixture->expected->str, fixture->expected->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+// curl rewinds after reading part of the body when it sends it again
+static void
+test_rewind(BodyFixture *fixture, gconstpointer data) {
+	const gsize size = fixture->expected->len;
+	gchar *dest = g_malloc(4093);
+
+	for (gsize partial = 1; partial < size; partial = partial * 3 + 1) {
+		GString *out;
+		gsize done = 0;
+
+		g_assert_cmpint(gst_gemini_body_seek(fixture->body, 0, SEEK_SET), ==, CURL_SEEKFUNC_OK);
+		while (done < partial) {
+			done += gst_gemini_body_read(dest, 1, MIN(4093, partial - done), fixture->body);
+		}
+		g_assert_cmpint(gst_gemini_body_seek(fixture->body, 0, SEEK_SET), ==, CURL_SEEKFUNC_OK);
+		out = read_body(fixture->body, 7);
+		g_assert_cmpmem(out->str, out->len, fixture->expected->str, size);
+		g_string_free(out, TRUE);
+	}
+	g_free(dest);
+}
+
+// Seeks into the middle of base64 groups and text, as a resumed upload would
+static void
+test_seek(BodyFixture *fixture, gconstpointer data) {
+	const gsize size = fixture->expected->len;
+
+	for (gsize offset = 0; offset <= size; offset += offset < 200 ? 1 : 997) {
+		GString *out;
+
+		g_assert_cmpint(gst_gemini_body_seek(fixture->body, offset, SEEK_SET), ==, CURL_SEEKFUNC_OK);
+		out = read_body(fixture->body, 4093);
+		g_assert_cmpmem(out->str, out->len, fixture->expected->str + offset, size - offset);
+		g_string_free(out, TRUE);
+	}
+
+	g_assert_cmpint(gst_gemini_body_seek(fixture->body, size + 1, SEEK_SET), ==, CURL_SEEKFUNC_FAIL);
+	g_assert_cmpint(gst_gemini_body_seek(fixture->body, -1, SEEK_SET), ==, CURL_SEEKFUNC_FAIL);
+	g_assert_cmpint(gst_gemini_body_seek(fixture->body, 0, SEEK_CUR), ==, CURL_SEEKFUNC_FAIL);
+}
+
+int
+main(int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+	gst_init(&argc, &argv);
+	GST_DEBUG_CATEGORY_INIT(gst_gemini_vision_debug_category, "geminivision", 0, "Gemini Vision Processor");
+
+	g_test_add("/body/read", BodyFixture, NULL, fixture_set_up, test_read, fixture_tear_down);
+	g_test_add("/body/rewind", BodyFixture, NULL, fixture_set_up, test_rewind, fixture_tear_down);
+	g_test_add("/body/seek", BodyFixture, NULL, fixture_set_up, test_seek, fixture_tear_down);
+	return g_test_run();
+}
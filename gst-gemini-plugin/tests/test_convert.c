@@ -0,0 +1,280 @@
+// tests/test_convert.c
+// Checks every vector kernel the CPU can run against the scalar one, on
+// widths that leave tails of every length. The kernels are static, so the
+// source is included rather than linked.
+#include "../src/gstgeminiconvert.c"
+
+#include <glib.h>
+
+// Bytes after the output that no kernel may touch. Not zero, vector
+// stores past the end tend to write zeros.
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xa5
+
+static const struct {
+	GstVideoFormat format;
+	GstGeminiRowConvertFunc c_func;
+} rgb_formats[] = {
+	{ GST_VIDEO_FORMAT_BGR, convert_c_bgr },
+	{ GST_VIDEO_FORMAT_RGBx, convert_c_rgbx },
+	{ GST_VIDEO_FORMAT_RGBA, convert_c_rgbx },
+	{ GST_VIDEO_FORMAT_BGRx, convert_c_bgrx },
+	{ GST_VIDEO_FORMAT_BGRA, convert_c_bgrx },
+	{ GST_VIDEO_FORMAT_xRGB, convert_c_xrgb },
+	{ GST_VIDEO_FORMAT_ARGB, convert_c_xrgb },
+	{ GST_VIDEO_FORMAT_xBGR, convert_c_xbgr },
+	{ GST_VIDEO_FORMAT_ABGR, convert_c_xbgr },
+};
+
+// Odd widths around the vector sizes, and odd frame widths
+static const gint widths[] = { 1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31, 33, 35, 47, 49, 63, 65, 95, 97, 127, 129, 321, 639, 1279, 1919 };
+
+static guint8 *
+random_bytes(gsize size) {
+	guint8 *data = g_malloc(size);
+
+	for (gsize i = 0; i < size; i++) {
+		data[i] = g_test_rand_int_range(0, 256);
+	}
+	return data;
+}
+
+// func NULL checks the kernel selected for each format
+static void
+check_converter(GstGeminiRowConvertFunc func, const gchar *impl, guint min_pstride) {
+	for (guint f = 0; f < G_N_ELEMENTS(rgb_formats); f++) {
+		GstGeminiRowConverter conv;
+
+		g_assert_true(gst_gemini_row_converter_init(&conv, rgb_formats[f].format));
+		if (conv.src_pstride < min_pstride) {
+			continue;
+		}
+		for (guint w = 0; w < G_N_ELEMENTS(widths); w++) {
+			const gint width = widths[w];
+			const gsize out_size = (gsize) width * 3;
+			guint8 *src = random_bytes((gsize) width * conv.src_pstride);
+			guint8 *expected = g_malloc(out_size + GUARD_SIZE);
+			guint8 *actual = g_malloc(out_size + GUARD_SIZE);
+
+			memset(expected, GUARD_BYTE, out_size + GUARD_SIZE);
+			memset(actual, GUARD_BYTE, out_size + GUARD_SIZE);
+
+			rgb_formats[f].c_func(&conv, src, expected, width);
+			(func ? func : conv.func)(&conv, src, actual, width);
+			if (memcmp(expected, actual, out_size + GUARD_SIZE) != 0) {
+				g_test_message(
+					"%s differs from c for %s at width %d", 
+					func ? impl : conv.impl, 
+					gst_video_format_to_string(rgb_formats[f].format), 
+					width
+				);
+				g_test_fail();
+			}
+			g_free(src);
+			g_free(expected);
+			g_free(actual);
+		}
+	}
+}
+
+static void
+check_deinterleave(GstGeminiDeinterleaveFunc func, const gchar *impl) {
+	for (guint w = 0; w < G_N_ELEMENTS(widths); w++) {
+		const gint n = widths[w];
+		guint8 *src = random_bytes((gsize) n * 2);
+		guint8 *expected = g_malloc((n + GUARD_SIZE) * 2);
+		guint8 *actual = g_malloc((n + GUARD_SIZE) * 2);
+
+		memset(expected, GUARD_BYTE, (n + GUARD_SIZE) * 2);
+		memset(actual, GUARD_BYTE, (n + GUARD_SIZE) * 2);
+
+		deinterleave_c(src, expected, expected + n + GUARD_SIZE, n);
+		func(src, actual, actual + n + GUARD_SIZE, n);
+		if (memcmp(expected, actual, (n + GUARD_SIZE) * 2) != 0) {
+			g_test_message("%s deinterleave differs from c for %d pairs", impl, n);
+			g_test_fail();
+		}
+		g_free(src);
+		g_free(expected);
+		g_free(actual);
+	}
+}
+
+// Offsets from an aligned allocation, so vector loads and stores meet every
+// alignment
+#define MAX_MISALIGN 3
+
+static void
+check_accumulate(GstGeminiAccumulateFunc func, const gchar *impl) {
+	for (guint w = 0; w < G_N_ELEMENTS(widths); w++) {
+		for (gint shift = 0; shift <= MAX_MISALIGN; shift++) {
+			const gint n = widths[w];
+			const gsize acc_size = (n + shift + GUARD_SIZE) * sizeof(guint16);
+			guint8 *src = random_bytes(n + shift);
+			// Random sums, additions that wrap must wrap the same way
+			guint16 *expected = (guint16 *) random_bytes(acc_size);
+			guint16 *actual = g_malloc(acc_size);
+
+			memcpy(actual, expected, acc_size);
+
+			accumulate_c(expected + shift, src + shift, n);
+			func(actual + shift, src + shift, n);
+			if (memcmp(expected, actual, acc_size) != 0) {
+				g_test_message("%s accumulate differs from c for %d columns at offset %d", impl, n, shift);
+				g_test_fail();
+			}
+			g_free(src);
+			g_free(expected);
+			g_free(actual);
+		}
+	}
+}
+
+typedef guint64 (*SadFunc) (const guint8 *a, const guint8 *b, gsize n);
+
+static void
+check_sad(SadFunc func, const gchar *impl) {
+	for (guint w = 0; w < G_N_ELEMENTS(widths); w++) {
+		for (gint shift = 0; shift <= MAX_MISALIGN; shift++) {
+			const gsize n = widths[w] * 3;
+			guint8 *a = random_bytes(n + shift);
+			guint8 *b = random_bytes(n + shift + 1);
+
+			// a and b misaligned differently
+			if (func(a + shift, b + shift + 1, n) != sad_c(a + shift, b + shift + 1, n)) {
+				g_test_message("%s sad differs from c for %" G_GSIZE_FORMAT " bytes at offset %d", impl, n, shift);
+				g_test_fail();
+			}
+			g_free(a);
+			g_free(b);
+		}
+	}
+
+	// Largest differences over a whole frame, the lane sums must not overflow
+	const gsize n = 1920 * 1080 + 17;
+	guint8 *a = g_malloc(n);
+	guint8 *b = g_malloc0(n);
+
+	memset(a, 0xff, n);
+	g_assert_cmpuint(func(a, b, n), ==, (guint64) n * 255);
+	g_assert_cmpuint(func(b, a, n), ==, (guint64) n * 255);
+	g_free(a);
+	g_free(b);
+}
+
+typedef void (*Base64Func) (const guint8 *src, gsize len, gchar *dst);
+
+// Every length up to three blocks of the kernel and a partial group, so
+// each block count meets each tail. The source is allocated to its exact
+// length, reads past it show up under a memory checker.
+static void
+check_base64(Base64Func func, const gchar *impl, gsize block) {
+	for (gsize len = 0; len <= 3 * block + 2; len++) {
+		const gsize out_size = (len + 2) / 3 * 4;
+		guint8 *src = random_bytes(len);
+		gchar *expected = g_base64_encode(src, len);
+		gchar *actual = g_malloc(out_size + GUARD_SIZE);
+
+		memset(actual, GUARD_BYTE, out_size + GUARD_SIZE);
+		func(src, len, actual);
+		g_assert_cmpuint(strlen(expected), ==, out_size);
+		if (memcmp(expected, actual, out_size) != 0) {
+			g_test_message("%s base64 differs from g_base64_encode for %" G_GSIZE_FORMAT " bytes", impl, len);
+			g_test_fail();
+		}
+		for (gsize i = out_size; i < out_size + GUARD_SIZE; i++) {
+			if ((guint8) actual[i] != GUARD_BYTE) {
+				g_test_message("%s base64 writes past %" G_GSIZE_FORMAT " characters", impl, out_size);
+				g_test_fail();
+				break;
+			}
+		}
+		g_free(src);
+		g_free(expected);
+		g_free(actual);
+	}
+}
+
+#ifdef GEMINI_HAVE_X86_KERNELS
+static void
+test_sse2(void) {
+	check_deinterleave(deinterleave_sse2, "sse2");
+	check_accumulate(accumulate_sse2, "sse2");
+	check_sad(sad_sse2, "sse2");
+}
+
+static void
+test_ssse3(void) {
+	if (!__builtin_cpu_supports("ssse3")) {
+		g_test_skip("No SSSE3");
+		return;
+	}
+	check_converter(convert_ssse3, "ssse3", 3);
+	check_base64(base64_encode_ssse3, "ssse3", 12);
+}
+
+static void
+test_avx2(void) {
+	if (!__builtin_cpu_supports("avx2")) {
+		g_test_skip("No AVX2");
+		return;
+	}
+	// There is no AVX2 kernel for 3-byte pixels
+	check_converter(convert_avx2, "avx2", 4);
+	check_deinterleave(deinterleave_avx2, "avx2");
+	check_base64(base64_encode_avx2, "avx2", 24);
+	check_accumulate(accumulate_avx2, "avx2");
+	check_sad(sad_avx2, "avx2");
+}
+#endif
+
+#ifdef GEMINI_HAVE_NEON_KERNELS
+static void
+test_neon(void) {
+	check_converter(convert_neon, "neon", 3);
+	check_deinterleave(deinterleave_neon, "neon");
+	check_base64(base64_encode_neon, "neon", 48);
+	check_accumulate(accumulate_neon, "neon");
+	check_sad(sad_neon, "neon");
+}
+#endif
+
+// The scalar kernels the vector ones fall back to for their tails
+static void
+test_c(void) {
+	check_base64(base64_encode_c, "c", 3);
+}
+
+// Whatever the CPU, the kernels gst_gemini_row_converter_init(),
+// gst_gemini_scaler_init(), gst_gemini_sad() and gst_gemini_base64_encode()
+// pick
+static void
+test_selected(void) {
+	const gchar *impl = gst_gemini_convert_get_cpu_impl();
+	GstGeminiScaler scaler = { 0 };
+
+	check_converter(NULL, NULL, 3);
+	gst_gemini_scaler_init(&scaler, 64, 64, 32, 32, 1);
+	check_accumulate(scaler.accumulate, impl);
+	gst_gemini_scaler_clear(&scaler);
+	check_sad(gst_gemini_sad, impl);
+	check_base64(gst_gemini_base64_encode, impl, 48);
+}
+
+int
+main(int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/convert/c", test_c);
+#ifdef GEMINI_HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	g_test_add_func("/convert/sse2", test_sse2);
+	g_test_add_func("/convert/ssse3", test_ssse3);
+	g_test_add_func("/convert/avx2", test_avx2);
+#endif
+#ifdef GEMINI_HAVE_NEON_KERNELS
+	g_test_add_func("/convert/neon", test_neon);
+#endif
+	g_test_add_func("/convert/selected", test_selected);
+	return g_test_run();
+}
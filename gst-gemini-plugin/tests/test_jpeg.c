@@ -0,0 +1,198 @@
+// tests/test_jpeg.c
+// Checks that frames split into stripes by encode_image() and compressed on
+// several threads decode to the same image as with encoder-threads=1. The
+// frames go through the element's own encode path: raw YUV stripes starting
+// below the first line, 4:2:2 input encoded as 4:2:0, grayscale and RGB rows.
+// Heights are not multiples of the stripe size, so the last stripe is short.
+#include "../src/gstgeminivision.c"
+
+#include <glib.h>
+
+typedef struct {
+	const gchar *name;
+	GstVideoFormat format;
+	gint width, height;
+	GstGeminiEncoderProfile profile;
+	gboolean grayscale;
+} EncodeCase;
+
+static const EncodeCase encode_cases[] = {
+	// Stripes of 128 lines, the last one 44
+	{ "i420/balanced", GST_VIDEO_FORMAT_I420, 203, 300, GST_GEMINI_ENCODER_PROFILE_BALANCED, FALSE },
+	{ "i420/fast", GST_VIDEO_FORMAT_I420, 97, 517, GST_GEMINI_ENCODER_PROFILE_FAST, FALSE },
+	{ "nv12/balanced", GST_VIDEO_FORMAT_NV12, 320, 261, GST_GEMINI_ENCODER_PROFILE_BALANCED, FALSE },
+	{ "nv12/fast", GST_VIDEO_FORMAT_NV12, 641, 389, GST_GEMINI_ENCODER_PROFILE_FAST, FALSE },
+	// 4:2:2 kept, stripes of 64 lines, the last one 2
+	{ "yuy2/balanced", GST_VIDEO_FORMAT_YUY2, 161, 130, GST_GEMINI_ENCODER_PROFILE_BALANCED, FALSE },
+	// 4:2:2 encoded as 4:2:0, every other chroma line skipped
+	{ "yuy2/fast", GST_VIDEO_FORMAT_YUY2, 162, 300, GST_GEMINI_ENCODER_PROFILE_FAST, FALSE },
+	// Luma only, stripes of 64 lines
+	{ "i420/gray", GST_VIDEO_FORMAT_I420, 203, 300, GST_GEMINI_ENCODER_PROFILE_BALANCED, TRUE },
+	{ "nv12/gray", GST_VIDEO_FORMAT_NV12, 130, 257, GST_GEMINI_ENCODER_PROFILE_FAST, TRUE },
+	{ "yuy2/gray", GST_VIDEO_FORMAT_YUY2, 95, 201, GST_GEMINI_ENCODER_PROFILE_FAST, TRUE },
+	// Converted rows instead of raw data
+	{ "bgrx/balanced", GST_VIDEO_FORMAT_BGRx, 99, 300, GST_GEMINI_ENCODER_PROFILE_BALANCED, FALSE },
+	{ "rgb/gray", GST_VIDEO_FORMAT_RGB, 99, 150, GST_GEMINI_ENCODER_PROFILE_FAST, TRUE },
+};
+
+// Smooth content with noise in every plane, so every block has AC coefficients
+static GstBuffer *
+make_frame(const GstVideoInfo *info) {
+	GstBuffer *buffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(info), NULL);
+	GstVideoFrame frame;
+
+	g_assert_true(gst_video_frame_map(&frame, info, buffer, GST_MAP_WRITE));
+	for (guint p = 0; p < GST_VIDEO_FRAME_N_PLANES(&frame); p++) {
+		const gint stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, p);
+		guint8 *data = GST_VIDEO_FRAME_PLANE_DATA(&frame, p);
+		guint comp = 0;
+
+		while (GST_VIDEO_FRAME_COMP_PLANE(&frame, comp) != p) {
+			comp++;
+		}
+		const gint rows = GST_VIDEO_FRAME_COMP_HEIGHT(&frame, comp);
+
+		for (gint y = 0; y < rows; y++) {
+			for (gint x = 0; x < stride; x++) {
+				data[(gsize) y * stride + x] = (x * 3 + y * 2 + p * 64 + g_test_rand_int_range(0, 24)) & 0xff;
+			}
+		}
+	}
+	gst_video_frame_unmap(&frame);
+	return buffer;
+}
+
+// Compresses the frame the way the encoder thread does, with a fresh element
+static GstBuffer *
+encode(const EncodeCase *ec, const GstVideoInfo *info, GstBuffer *buffer, gint threads) {
+	GstGeminiVision *self = g_object_ref_sink(g_object_new(
+		GST_TYPE_GEMINI_VISION,
+		"encoder-threads", threads,
+		"encoder-profile", ec->profile,
+		"grayscale", ec->grayscale,
+		NULL
+	));
+	GstBuffer *jpeg = NULL;
+	GstVideoFrame frame;
+
+	g_assert_true(gst_video_frame_map(&frame, info, buffer, GST_MAP_READ));
+	g_assert_true(configure_encoder(self, info));
+	g_assert_true(encode_frame_to_jpeg(self, &frame, &jpeg));
+	gst_video_frame_unmap(&frame);
+
+	// Normally freed when the encoder thread ends
+	if (self->stripe_pool) {
+		g_thread_pool_free(self->stripe_pool, FALSE, TRUE);
+		self->stripe_pool = NULL;
+	}
+	gst_object_unref(self);
+	g_assert_nonnull(jpeg);
+	return jpeg;
+}
+
+// Number of restart markers, stripes are only joined with them in between
+static guint
+count_restart_markers(GstBuffer *jpeg) {
+	GstMapInfo map;
+	guint n = 0;
+
+	g_assert_true(gst_buffer_map(jpeg, &map, GST_MAP_READ));
+	for (gsize i = 0; i + 1 < map.size; i++) {
+		if (map.data[i] == 0xFF && map.data[i + 1] >= 0xD0 && map.data[i + 1] <= 0xD7) {
+			n++;
+		}
+	}
+	gst_buffer_unmap(jpeg, &map);
+	return n;
+}
+
+// Decodes jpeg and returns its pixels. A restart marker out of sequence
+// makes libjpeg warn and resynchronize, which fails the test.
+static guint8 *
+decode(GstBuffer *jpeg, gint *width, gint *height, gint *components) {
+	struct jpeg_decompress_struct dinfo;
+	struct jpeg_error_mgr jerr;
+	GstMapInfo map;
+	guint8 *pixels;
+	gsize stride;
+
+	g_assert_true(gst_buffer_map(jpeg, &map, GST_MAP_READ));
+	dinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_decompress(&dinfo);
+	jpeg_mem_src(&dinfo, map.data, map.size);
+	g_assert_cmpint(jpeg_read_header(&dinfo, TRUE), ==, JPEG_HEADER_OK);
+	jpeg_start_decompress(&dinfo);
+
+	*width = dinfo.output_width;
+	*height = dinfo.output_height;
+	*components = dinfo.output_components;
+	stride = (gsize) dinfo.output_width * dinfo.output_components;
+	pixels = g_malloc(stride * dinfo.output_height);
+	while (dinfo.output_scanline < dinfo.output_height) {
+		JSAMPROW row = pixels + stride * dinfo.output_scanline;
+
+		jpeg_read_scanlines(&dinfo, &row, 1);
+	}
+	jpeg_finish_decompress(&dinfo);
+	g_assert_cmpint(jerr.num_warnings, ==, 0);
+
+	jpeg_destroy_decompress(&dinfo);
+	gst_buffer_unmap(jpeg, &map);
+	return pixels;
+}
+
+static void
+test_stripes(gconstpointer data) {
+	const EncodeCase *ec = data;
+	GstVideoInfo info;
+	GstBuffer *buffer, *single, *striped;
+	guint8 *single_pixels, *striped_pixels;
+	gint single_w, single_h, single_c, striped_w, striped_h, striped_c;
+
+	gst_video_info_set_format(&info, ec->format, ec->width, ec->height);
+	buffer = make_frame(&info);
+	single = encode(ec, &info, buffer, 1);
+	striped = encode(ec, &info, buffer, 4);
+	g_assert_cmpuint(count_restart_markers(single), ==, 0);
+	g_assert_cmpuint(count_restart_markers(striped), >, 0);
+
+	single_pixels = decode(single, &single_w, &single_h, &single_c);
+	striped_pixels = decode(striped, &striped_w, &striped_h, &striped_c);
+	g_assert_cmpint(striped_w, ==, ec->width);
+	g_assert_cmpint(striped_h, ==, ec->height);
+	g_assert_cmpint(striped_c, ==, ec->grayscale ? 1 : 3);
+	g_assert_cmpint(single_c, ==, striped_c);
+	g_assert_cmpmem(striped_pixels, (gsize) striped_w * striped_h * striped_c,
+		single_pixels, (gsize) single_w * single_h * single_c);
+
+	g_free(single_pixels);
+	g_free(striped_pixels);
+	gst_buffer_unref(single);
+	gst_buffer_unref(striped);
+	gst_buffer_unref(buffer);
+}
+
+// A stripe that is not a JPEG is refused rather than joined
+static void
+test_join_garbage(void) {
+	GstBuffer *stripe = gst_buffer_new_wrapped(g_strdup("not a jpeg"), 10);
+
+	g_assert_null(gst_gemini_jpeg_join_stripes(&stripe, 1, 16));
+	gst_buffer_unref(stripe);
+}
+
+int
+main(int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+	gst_init(&argc, &argv);
+	GST_DEBUG_CATEGORY_INIT(gst_gemini_vision_debug_category, "geminivision", 0, "Gemini Vision Processor");
+
+	for (guint i = 0; i < G_N_ELEMENTS(encode_cases); i++) {
+		gchar *path = g_strdup_printf("/jpeg/stripes/%s", encode_cases[i].name);
+
+		g_test_add_data_func(path, &encode_cases[i], test_stripes);
+		g_free(path);
+	}
+	g_test_add_func("/jpeg/join/garbage", test_join_garbage);
+	return g_test_run();
+}
@@ -0,0 +1,262 @@
+// tests/test_response.c
+// Feeds generateContent responses to the streaming reader in chunks of
+// every size from single bytes to the whole body, and compares the text,
+// finishReason, usage and error message with the known values. curl hands
+// over whatever arrived, so tokens, escapes and UTF-8 sequences are split
+// at arbitrary places.
+#include "../src/gstgeminiresponse.c"
+
+#include <glib.h>
+
+typedef struct {
+	const gchar *name;
+	const gchar *body;
+	gboolean sse;
+	gboolean valid;
+	const gchar *text;          // NULL when the response has none
+	const gchar *finish_reason;
+	const gchar *error;
+	gboolean has_usage;
+	gint64 prompt_tokens, candidates_tokens, total_tokens, cached_tokens;
+	guint n_events;             // Events ending with an empty line, for SSE
+} ResponseCase;
+
+static const ResponseCase response_cases[] = {
+	{
+		"plain",
+		"{\n"
+		"  \"candidates\": [\n"
+		"    {\n"
+		"      \"content\": {\n"
+		"        \"parts\": [\n"
+		"          { \"text\": \"A cat called \\\"Tom\\\" sits on a mat\\n\\tby the door\\\\window. \" },\n"
+		"          { \"text\": \"Caf\\u00e9 sign, \\ud83d\\ude00 and \xf0\x9f\x90\x88 stickers, 1\\/2 price.\" }\n"
+		"        ],\n"
+		"        \"role\": \"model\"\n"
+		"      },\n"
+		"      \"finishReason\": \"STOP\",\n"
+		"      \"index\": 0,\n"
+		"      \"safetyRatings\": [\n"
+		"        { \"category\": \"HARM_CATEGORY_HARASSMENT\", \"probability\": \"NEGLIGIBLE\" },\n"
+		"        { \"category\": \"HARM_CATEGORY_HATE_SPEECH\", \"probability\": \"NEGLIGIBLE\" }\n"
+		"      ]\n"
+		"    },\n"
+		"    { \"content\": { \"parts\": [ { \"text\": \"Second candidate\" } ] }, \"finishReason\": \"MAX_TOKENS\" }\n"
+		"  ],\n"
+		"  \"usageMetadata\": {\n"
+		"    \"promptTokenCount\": 1290,\n"
+		"    \"candidatesTokenCount\": 27,\n"
+		"    \"totalTokenCount\": 1317,\n"
+		"    \"cachedContentTokenCount\": 1024,\n"
+		"    \"promptTokensDetails\": [ { \"modality\": \"IMAGE\", \"tokenCount\": 1290 } ]\n"
+		"  },\n"
+		"  \"modelVersion\": \"gemini-2.0-flash\"\n"
+		"}\n",
+		FALSE, TRUE,
+		"A cat called \"Tom\" sits on a mat\n\tby the door\\window. "
+		"Caf\xc3\xa9 sign, \xf0\x9f\x98\x80 and \xf0\x9f\x90\x88 stickers, 1/2 price.",
+		"STOP", NULL,
+		TRUE, 1290, 27, 1317, 1024, 0
+	},
+	{
+		"error",
+		"{\n"
+		"  \"error\": {\n"
+		"    \"code\": 429,\n"
+		"    \"message\": \"Resource has been exhausted (e.g. check \\\"quota\\\").\",\n"
+		"    \"status\": \"RESOURCE_EXHAUSTED\"\n"
+		"  }\n"
+		"}\n",
+		FALSE, TRUE,
+		NULL, NULL, "Resource has been exhausted (e.g. check \"quota\").",
+		FALSE, -1, -1, -1, -1, 0
+	},
+	{
+		"error-without-message",
+		"{\"error\":{\"code\":500,\"status\":\"INTERNAL\"}}",
+		FALSE, TRUE,
+		NULL, NULL, "",
+		FALSE, -1, -1, -1, -1, 0
+	},
+	{
+		"not-json",
+		"<html><body>502 Bad Gateway</body></html>",
+		FALSE, FALSE,
+		NULL, NULL, NULL,
+		FALSE, -1, -1, -1, -1, 0
+	},
+	{
+		// Text arrives over several events, usage with the last one. The
+		// second event has its JSON on two data lines.
+		"sse",
+		"data: {\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"A red \\u00e9\"}],\"role\": \"model\"},\"index\": 0}],"
+		"\"usageMetadata\": {\"promptTokenCount\": 258,\"totalTokenCount\": 258}}\r\n"
+		"\r\n"
+		": keep-alive\r\n"
+		"data: {\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"clair \\ud83d\\ude97 \"}],\n"
+		"data: \"role\": \"model\"},\"index\": 0}]}\r\n"
+		"\r\n"
+		"data:{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"parked \xf0\x9f\x85\xbf\\n\"}],\"role\": \"model\"},"
+		"\"finishReason\": \"STOP\",\"index\": 0}],"
+		"\"usageMetadata\": {\"promptTokenCount\": 258,\"candidatesTokenCount\": 9,\"totalTokenCount\": 267}}\r\n"
+		"\r\n",
+		TRUE, TRUE,
+		"A red \xc3\xa9" "clair \xf0\x9f\x9a\x97 parked \xf0\x9f\x85\xbf\n",
+		"STOP", NULL,
+		TRUE, 258, 9, 267, -1, 3
+	},
+	{
+		// The last event is ended by gst_gemini_response_finish()
+		"sse-unterminated",
+		"data: {\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"Two \"}]}}]}\n"
+		"\n"
+		"data: {\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"boats\"}]},\"finishReason\": \"STOP\"}],"
+		"\"usageMetadata\": {\"promptTokenCount\": 10,\"candidatesTokenCount\": 2,\"totalTokenCount\": 12}}",
+		TRUE, TRUE,
+		"Two boats",
+		"STOP", NULL,
+		TRUE, 10, 2, 12, -1, 1
+	},
+	{
+		"sse-error",
+		"data: {\"error\": {\"code\": 400, \"message\": \"API key not valid. Please pass a valid API key.\", "
+		"\"status\": \"INVALID_ARGUMENT\"}}\n"
+		"\n",
+		TRUE, TRUE,
+		NULL, NULL, "API key not valid. Please pass a valid API key.",
+		FALSE, -1, -1, -1, -1, 1
+	},
+};
+
+// Chunk sizes, 0 for the whole body at once
+static const gsize chunk_sizes[] = { 1, 2, 3, 7, 64, 4096, 0 };
+
+typedef struct {
+	const ResponseCase *rc;
+	gsize chunk;
+} ChunkedCase;
+
+// Feeds body in pieces of chunk bytes, the way the write callback does.
+// Returns the number of events that ended.
+static guint
+feed(GstGeminiResponse *response, const gchar *body, gsize len, gboolean sse, gsize chunk) {
+	guint n_events = 0;
+
+	if (chunk == 0) {
+		chunk = MAX(len, 1);
+	}
+	for (gsize pos = 0; pos < len; pos += chunk) {
+		const gchar *data = body + pos;
+		gsize left = MIN(chunk, len - pos);
+
+		if (!sse) {
+			gst_gemini_response_feed(response, data, left);
+			continue;
+		}
+		while (left > 0) {
+			gboolean event_end;
+			gsize n = gst_gemini_response_feed_sse(response, data, left, &event_end);
+
+			g_assert_cmpuint(n, >, 0);
+			g_assert_cmpuint(n, <=, left);
+			data += n;
+			left -= n;
+			n_events += event_end;
+		}
+	}
+	gst_gemini_response_finish(response);
+	return n_events;
+}
+
+static void
+check(const GstGeminiResponse *response, const ResponseCase *rc) {
+	gint64 prompt_tokens, candidates_tokens, total_tokens;
+
+	g_assert_cmpint(gst_gemini_response_is_valid(response), ==, rc->valid);
+	g_assert_cmpstr(gst_gemini_response_get_text(response), ==, rc->text);
+	g_assert_cmpstr(gst_gemini_response_get_finish_reason(response), ==, rc->finish_reason);
+	g_assert_cmpstr(gst_gemini_response_get_error(response), ==, rc->error);
+	g_assert_cmpint(
+		gst_gemini_response_get_usage(response, &prompt_tokens, &candidates_tokens, &total_tokens),
+		==,
+		rc->has_usage
+	);
+	g_assert_cmpint(prompt_tokens, ==, rc->prompt_tokens);
+	g_assert_cmpint(candidates_tokens, ==, rc->candidates_tokens);
+	g_assert_cmpint(total_tokens, ==, rc->total_tokens);
+	g_assert_cmpint(gst_gemini_response_get_cached_tokens(response), ==, rc->cached_tokens);
+}
+
+static void
+test_chunked(gconstpointer data) {
+	const ChunkedCase *cc = data;
+	const ResponseCase *rc = cc->rc;
+	const gsize len = strlen(rc->body);
+	GstGeminiResponse *response = gst_gemini_response_new();
+
+	g_assert_cmpuint(feed(response, rc->body, len, rc->sse, cc->chunk), ==, rc->n_events);
+	check(response, rc);
+
+	// Responses are reused across requests, nothing may leak into the next one
+	gst_gemini_response_reset(response);
+	g_assert_cmpuint(feed(response, rc->body, len, rc->sse, cc->chunk), ==, rc->n_events);
+	check(response, rc);
+
+	gst_gemini_response_free(response);
+}
+
+// A text far longer than any chunk, with escapes spread over it
+static void
+test_long_text(void) {
+	GString *body = g_string_new("{\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"");
+	GString *text = g_string_new(NULL);
+	GstGeminiResponse *response = gst_gemini_response_new();
+
+	for (guint i = 0; i < 20000; i++) {
+		g_string_append_printf(body, "w%u \\\"\\u00e9\\ud83d\\ude00\\\" ", i);
+		g_string_append_printf(text, "w%u \"\xc3\xa9\xf0\x9f\x98\x80\" ", i);
+	}
+	g_string_append(body, "\"}]},\"finishReason\":\"MAX_TOKENS\"}]}");
+
+	for (guint i = 0; i < G_N_ELEMENTS(chunk_sizes); i++) {
+		gst_gemini_response_reset(response);
+		feed(response, body->str, body->len, FALSE, chunk_sizes[i]);
+		g_assert_true(gst_gemini_response_is_valid(response));
+		g_assert_cmpstr(gst_gemini_response_get_text(response), ==, text->str);
+		g_assert_cmpstr(gst_gemini_response_get_finish_reason(response), ==, "MAX_TOKENS");
+	}
+
+	gst_gemini_response_free(response);
+	g_string_free(text, TRUE);
+	g_string_free(body, TRUE);
+}
+
+int
+main(int argc, char **argv) {
+	ChunkedCase *cases = g_new(ChunkedCase, G_N_ELEMENTS(response_cases) * G_N_ELEMENTS(chunk_sizes));
+	guint n = 0;
+	int ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	for (guint i = 0; i < G_N_ELEMENTS(response_cases); i++) {
+		for (guint j = 0; j < G_N_ELEMENTS(chunk_sizes); j++, n++) {
+			gchar *path;
+
+			cases[n].rc = &response_cases[i];
+			cases[n].chunk = chunk_sizes[j];
+			if (chunk_sizes[j]) {
+				path = g_strdup_printf("/response/%s/%" G_GSIZE_FORMAT, response_cases[i].name, chunk_sizes[j]);
+			} else {
+				path = g_strdup_printf("/response/%s/whole", response_cases[i].name);
+			}
+			g_test_add_data_func(path, &cases[n], test_chunked);
+			g_free(path);
+		}
+	}
+	g_test_add_func("/response/long-text", test_long_text);
+
+	ret = g_test_run();
+	g_free(cases);
+	return ret;
+}